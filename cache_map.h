@@ -0,0 +1,518 @@
+#ifndef _CACHE_MAP_H_
+#define _CACHE_MAP_H_
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+#include "map.h"
+
+namespace mystl {
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief AVL balancing policy whose nodes carry intrusive recency and timer
+///        links, for cache_map
+/// @ingroup MySTL
+///
+/// Both lists are circular through a head that is itself a node_base, and an
+/// unlinked node points to itself. The links belong to the node, not to the
+/// entry, which is why cache_map removes nodes with map::extractor: it
+/// relinks nodes where map::eraser would move entries between them.
+////////////////////////////////////////////////////////////////////////////////
+struct cache_policy : avl_policy {
+  struct node_base;
+
+  /// @brief Links of one intrusive list
+  struct link {
+    node_base* prev; ///< Previous node or list head
+    node_base* next; ///< Next node or list head
+  };
+
+  /// @brief Per-node list links and expiry
+  struct node_base {
+    /// @brief Constructor, unlinked and never expiring
+    node_base() : lru{this, this}, timer{this, this}, expiry(0) {}
+
+    link lru;        ///< Recency list, most recently used first
+    link timer;      ///< Timer wheel slot
+    uint64_t expiry; ///< Tick at which the entry expires, 0 for never
+  };
+
+  typedef link node_base::*list; ///< Selects one of the lists of a node
+
+  /// @brief Unlink a node from a list, leaving it linked to itself
+  /// @param l List
+  /// @param n Node
+  static void unlink(list l, node_base* n) {
+    ((n->*l).prev->*l).next = (n->*l).next;
+    ((n->*l).next->*l).prev = (n->*l).prev;
+    (n->*l).prev = (n->*l).next = n;
+  }
+  /// @brief Link a node right after a position
+  /// @param l List
+  /// @param p Position, a node or the list head
+  /// @param n Unlinked node
+  static void link_after(list l, node_base* p, node_base* n) {
+    (n->*l).prev = p;
+    (n->*l).next = (p->*l).next;
+    ((p->*l).next->*l).prev = n;
+    (p->*l).next = n;
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Ordered map bounded in size and entry lifetime, evicting the least
+///        recently used or expired entries
+/// @ingroup MySTL
+/// @tparam Key Key type
+/// @tparam Value Value type
+/// @tparam Clock Clock measuring entry lifetimes
+///
+/// Every node is linked into a recency list, moved to its front by find,
+/// operator[], at and insert. An insert beyond the capacity removes the node
+/// at the back. Entries with a time to live are also linked into a
+/// hierarchical timer wheel of 4 levels of 64 slots, each level counting in
+/// ticks 64 times longer than the one below. Slots of a level are cascaded
+/// down as the lower level wraps, and entries fire from level 0 within one
+/// tick after their lifetime. Both evictions take O(1) plus the cost of
+/// unlinking one node from the tree; the tree is never scanned.
+///
+/// Non-const operations first expire what is due. Const lookups treat due
+/// entries as missing but do not remove them, and iteration yields them until
+/// the next non-const operation or expire().
+////////////////////////////////////////////////////////////////////////////////
+template<typename Key, typename Value,
+  typename Clock = std::chrono::steady_clock>
+class cache_map : private map<Key, Value, 0, false, cache_policy> {
+
+  typedef map<Key, Value, 0, false, cache_policy> base; ///< Underlying map
+  typedef typename base::node node;                     ///< Tree node
+  typedef cache_policy::node_base node_base;            ///< Node links
+
+  public:
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Types
+    /// @{
+
+    typedef typename base::key_type key_type;       ///< Key type
+    typedef typename base::mapped_type mapped_type; ///< Value type
+    typedef typename base::value_type value_type;   ///< (Key, Value) pair
+    typedef typename base::iterator iterator;       ///< Iterator
+    typedef typename base::const_iterator
+      const_iterator;                               ///< Const iterator
+    typedef typename base::reverse_iterator
+      reverse_iterator;                             ///< Reverse iterator
+    typedef typename base::const_reverse_iterator
+      const_reverse_iterator;                       ///< Const reverse iterator
+    typedef typename Clock::duration duration;      ///< Lifetime type
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Constructors
+    /// @{
+
+    /// @brief Constructor
+    /// @param capacity Largest number of entries, 0 for no bound
+    /// @param ttl Default lifetime of an entry, zero for no expiry
+    /// @param resolution Length of a tick of the timer wheel
+    explicit cache_map(size_t capacity, duration ttl = duration::zero(),
+        duration resolution = std::chrono::milliseconds(1)) :
+      cap(capacity), life(ttl), tick(resolution), epoch(Clock::now()),
+      current(0), timed(0), occupied() {}
+
+    /// @brief Copy constructor, keeping recency order and expiries
+    /// @param m Other cache
+    cache_map(const cache_map& m) :
+      base(m), cap(m.cap), life(m.life), tick(m.tick), epoch(m.epoch),
+      current(m.current), timed(0), occupied() {
+      relink(m);
+    }
+
+    /// @brief Copy assignment
+    /// @param m Other cache
+    /// @return Reference to self
+    cache_map& operator=(const cache_map& m) {
+      if(this != &m) {
+        base::operator=(m);
+        reset();
+        cap = m.cap;
+        life = m.life;
+        tick = m.tick;
+        epoch = m.epoch;
+        current = m.current;
+        relink(m);
+      }
+      return *this;
+    }
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Inherited from map
+    /// @{
+
+    using base::begin;
+    using base::end;
+    using base::rbegin;
+    using base::rend;
+    using base::cbegin;
+    using base::cend;
+    using base::crbegin;
+    using base::crend;
+    using base::size;
+    using base::empty;
+    using base::height;
+    using base::memory_usage;
+    using base::balanced;
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Capacity
+    /// @{
+
+    /// @return Largest number of entries, 0 for no bound
+    size_t capacity() const {return cap;}
+    /// @return Default lifetime of an entry, zero for no expiry
+    duration ttl() const {return life;}
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Element Access
+    /// @{
+
+    /// @param k Input key
+    /// @return Value at given key, inserted with the default lifetime and a
+    ///         default constructed value if \c k is not in the cache
+    Value& operator[](const Key& k) {
+      expire();
+      std::pair<node*, bool> a = base::inserter(std::make_pair(k, Value()));
+      if(a.second) {
+        base::rebalance_insert(a.first);
+        schedule(a.first, life);
+      }
+      use(a.first);
+      evict();
+      return a.first->entry().second;
+    }
+
+    /// @param k Input key
+    /// @return Value at given key
+    ///
+    /// If \c k is not found in the cache, the function throws an
+    /// \c out_of_range exception.
+    Value& at(const Key& k) {
+      iterator i = find(k);
+      if(i == end()) throw std::out_of_range("Error: key is not in the map");
+      return i->second;
+    }
+
+    /// @param k Input key
+    /// @return Value at given key
+    ///
+    /// If \c k is not found in the cache, the function throws an
+    /// \c out_of_range exception.
+    const Value& at(const Key& k) const {
+      const_iterator i = find(k);
+      if(i == cend()) throw std::out_of_range("Error: key is not in the map");
+      return i->second;
+    }
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Modifiers
+    /// @{
+
+    /// @brief Insert or overwrite an entry with the default lifetime
+    /// @param v Key, Value pair
+    /// @return pair of iterator to the entry and bool, true if it was new
+    std::pair<iterator, bool> insert(const value_type& v) {
+      return insert(v, life);
+    }
+
+    /// @brief Insert or overwrite an entry, restarting its lifetime
+    /// @param v Key, Value pair
+    /// @param ttl Lifetime, zero for no expiry
+    /// @return pair of iterator to the entry and bool, true if it was new
+    std::pair<iterator, bool> insert(const value_type& v, duration ttl) {
+      expire();
+      std::pair<node*, bool> a = base::inserter(v);
+      if(a.second) base::rebalance_insert(a.first);
+      else a.first->entry().second = v.second;
+      schedule(a.first, ttl);
+      use(a.first);
+      evict();
+      return std::make_pair(iterator(a.first), a.second);
+    }
+
+    /// @brief Remove element at specified position
+    /// @param position Position
+    /// @return Position of the element after the removed one
+    iterator erase(const_iterator position) {
+      node* n = position.n;
+      iterator next(n->inorder_next());
+      drop(n);
+      return next;
+    }
+
+    /// @brief Remove element with a key
+    /// @param k Key
+    /// @return Number of elements removed (in this case it is at most 1)
+    size_t erase(const Key& k) {
+      expire();
+      node* n = base::lookup(k);
+      if(!n) return 0;
+      drop(n);
+      return 1;
+    }
+
+    /// @brief Remove every entry that is due
+    /// @return Number of entries removed
+    ///
+    /// Advances the timer wheel to the current tick, jumping over empty
+    /// stretches of level 0 and stopping at most once per level 0 wrap.
+    size_t expire() {
+      size_t n = size();
+      uint64_t target = now();
+      while(current < target) {
+        if(timed == 0) {
+          current = target;
+          break;
+        }
+        uint64_t next = (current | (slots - 1)) + 1;
+        size_t i = current & (slots - 1);
+        uint64_t m = i + 1 < slots ? occupied[0] >> (i + 1) << (i + 1) : 0;
+        if(m) next = (current & ~uint64_t(slots - 1)) + lowest_bit(m);
+        if(next > target) {
+          current = target;
+          break;
+        }
+        current = next;
+        for(size_t l = levels - 1; l > 0; --l)
+          if((current & ((uint64_t(1) << (bits * l)) - 1)) == 0)
+            cascade(l, (current >> (bits * l)) & (slots - 1));
+        node_base* h = head(0, current & (slots - 1));
+        while(h->timer.next != h)
+          drop(static_cast<node*>(h->timer.next));
+        occupied[0] &= ~(uint64_t(1) << (current & (slots - 1)));
+      }
+      return n - size();
+    }
+
+    /// @brief Removes all elements
+    void clear() noexcept {
+      base::clear();
+      reset();
+    }
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Operations
+    /// @{
+
+    /// @brief Search the cache for an element with key \c k, marking it most
+    ///        recently used
+    /// @param k Key
+    /// @return Iterator to position if found, end() otherwise
+    iterator find(const Key& k) {
+      expire();
+      node* n = base::lookup(k);
+      if(!n) return end();
+      use(n);
+      return iterator(n);
+    }
+
+    /// @brief Search the cache for an element with key \c k that is not due
+    /// @param k Key
+    /// @return Iterator to position if found, cend() otherwise
+    const_iterator find(const Key& k) const {
+      node* n = base::lookup(k);
+      return n && !(n->expiry && n->expiry <= now()) ?
+        const_iterator(n) : cend();
+    }
+
+    /// @param k Key
+    /// @return Count of elements with key \c k that are not due, 1 or 0
+    size_t count(const Key& k) const {return find(k) != cend() ? 1 : 0;}
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+  private:
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Helpers
+    /// @{
+
+    /// @return Ticks elapsed since construction
+    uint64_t now() const {return uint64_t((Clock::now() - epoch) / tick);}
+
+    /// @param l Level
+    /// @param s Slot
+    /// @return List head of a slot of the timer wheel
+    node_base* head(size_t l, size_t s) const {return &wheel[l * slots + s];}
+
+    /// @param m Nonzero mask
+    /// @return Index of the lowest set bit
+    static size_t lowest_bit(uint64_t m) {
+#if defined(__GNUC__)
+      return __builtin_ctzll(m);
+#else
+      size_t i = 0;
+      for(; !(m & 1); m >>= 1) ++i;
+      return i;
+#endif
+    }
+
+    /// @brief Move a node to the front of the recency list
+    /// @param n Node
+    void use(node_base* n) {
+      cache_policy::unlink(&node_base::lru, n);
+      cache_policy::link_after(&node_base::lru, &recent, n);
+    }
+
+    /// @brief Remove least recently used entries beyond the capacity
+    void evict() {
+      while(cap && size() > cap)
+        drop(static_cast<node*>(recent.lru.prev));
+    }
+
+    /// @brief Unlink a node from both lists and the tree, and free it
+    /// @param n Node
+    void drop(node* n) {
+      cache_policy::unlink(&node_base::lru, n);
+      if(n->expiry) {
+        cache_policy::unlink(&node_base::timer, n);
+        --timed;
+      }
+      node* h = base::extractor(n);
+      node::destroy(h->left);
+      node::destroy(h);
+    }
+
+    /// @brief Set the lifetime of an entry, replacing any earlier one
+    /// @param n Node
+    /// @param ttl Lifetime from now, zero for no expiry
+    void schedule(node_base* n, duration ttl) {
+      if(n->expiry) {
+        cache_policy::unlink(&node_base::timer, n);
+        n->expiry = 0;
+        --timed;
+      }
+      if(ttl <= duration::zero()) return;
+      uint64_t t = now();
+      if(t < current) t = current;
+      // one more tick, since now() may be late in the current tick
+      n->expiry = t + uint64_t((ttl + tick - duration(1)) / tick) + 1;
+      place(n);
+    }
+
+    /// @brief Link a node with an expiry into the timer wheel
+    /// @param n Node whose expiry is not before the current tick
+    ///
+    /// The level is the lowest whose slots tell the expiry apart from the
+    /// current tick. Expiries beyond the top level wait in the top slot that
+    /// is cascaded next, and are placed again from there.
+    void place(node_base* n) {
+      if(!wheel) wheel.reset(new node_base[levels * slots]);
+      uint64_t e = n->expiry;
+      size_t l = 0;
+      while(l < levels && (e >> (bits * (l + 1))) != (current >> (bits * (l + 1))))
+        ++l;
+      size_t s;
+      if(l == levels) {
+        l = levels - 1;
+        s = ((current >> (bits * l)) + 1) & (slots - 1);
+      }
+      else
+        s = (e >> (bits * l)) & (slots - 1);
+      cache_policy::link_after(&node_base::timer, head(l, s), n);
+      occupied[l] |= uint64_t(1) << s;
+      ++timed;
+    }
+
+    /// @brief Move the entries of a slot down to the levels they now fall in
+    /// @param l Level, above 0
+    /// @param s Slot
+    void cascade(size_t l, size_t s) {
+      node_base* h = head(l, s);
+      occupied[l] &= ~(uint64_t(1) << s);
+      // overflowing expiries go to the slot after this one, never back here
+      while(h->timer.next != h) {
+        node_base* n = h->timer.next;
+        cache_policy::unlink(&node_base::timer, n);
+        --timed;
+        place(n);
+      }
+    }
+
+    /// @brief Empty the recency list and the timer wheel
+    void reset() {
+      recent.lru.prev = recent.lru.next = &recent;
+      wheel.reset();
+      for(size_t l = 0; l < levels; ++l)
+        occupied[l] = 0;
+      timed = 0;
+    }
+
+    /// @brief Link the nodes of a fresh copy in the recency order and timer
+    ///        wheel of the source
+    /// @param m Source cache, whose tree this one's is a copy of
+    void relink(const cache_map& m) {
+      std::unordered_map<const node_base*, node*> copy;
+      const_iterator j = m.cbegin();
+      for(iterator i = begin(); i != end(); ++i, ++j)
+        copy[j.n] = i.n;
+      for(const node_base* s = m.recent.lru.next; s != &m.recent;
+          s = s->lru.next) {
+        node* c = copy[s];
+        cache_policy::link_after(&node_base::lru, recent.lru.prev, c);
+        if(s->expiry) {
+          c->expiry = s->expiry;
+          place(c);
+        }
+      }
+    }
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Data
+    /// @{
+
+    static constexpr size_t bits = 6;                   ///< Log2 of slots
+    static constexpr size_t slots = size_t(1) << bits;  ///< Slots per level
+    static constexpr size_t levels = 4;                 ///< Wheel levels
+
+    size_t cap;                         ///< Capacity, 0 for no bound
+    duration life;                      ///< Default lifetime
+    duration tick;                      ///< Timer wheel resolution
+    typename Clock::time_point epoch;   ///< Time of tick 0
+    uint64_t current;                   ///< Last tick the wheel advanced to
+    size_t timed;                       ///< Entries in the timer wheel
+    uint64_t occupied[levels];          ///< Slots that may be nonempty
+    node_base recent;                   ///< Head of the recency list
+    std::unique_ptr<node_base[]> wheel; ///< Slot heads, allocated on first use
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+};
+
+}
+
+#endif
@@ -0,0 +1,272 @@
+#ifndef _INTERVAL_MAP_H_
+#define _INTERVAL_MAP_H_
+
+#include <utility>
+
+#include "map.h"
+
+namespace mystl {
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief AVL balancing policy that also keeps the largest end point of every
+///        subtree
+/// @ingroup MySTL
+/// @tparam Key End point type
+///
+/// Meant for maps whose mapped type is a pair led by the end point, as in
+/// interval_map. Inserts and erases recompute the path above the change
+/// before rebalancing, so every rotation only has to recompute the two nodes
+/// it swaps. Bulk mode skips the hooks until end_bulk() rebuilds the tree.
+////////////////////////////////////////////////////////////////////////////////
+template<typename Key>
+struct interval_policy : avl_policy {
+  /// @brief Largest end point below the node
+  struct node_base {
+    /// @brief Constructor
+    node_base() : high() {}
+
+    Key high; ///< Largest end point of the entries in the subtree
+  };
+
+  /// @brief Update the path to the top, then restore balance
+  /// @param n New node
+  template<typename N>
+    static void inserted(N* n) {
+      update_path(n);
+      n->rebalance_insert();
+    }
+  /// @brief Update the path above the removed node, then restore balance
+  /// @param s Node promoted into the place of the removed one
+  template<typename N>
+    static void erased(N* s) {
+      update_path(s->get_parent());
+      s->rebalance();
+    }
+  /// @brief Update the node moved down by a rotation and its new parent
+  /// @param n Node now below its former child
+  template<typename N>
+    static void rotated(N* n) {
+      update(n);
+      update(n->get_parent());
+    }
+  /// @brief Take over balancing data and the largest end point
+  /// @param c Node taking the place of \c s
+  /// @param s Source node
+  template<typename N>
+    static void copied(N* c, const N& s) {
+      avl_policy::copied(c, s);
+      c->high = s.high;
+    }
+  /// @brief Set balancing data and the largest end point of a node whose
+  ///        subtrees were just built
+  /// @param n Node
+  /// @param hl Height of left subtree
+  /// @param hr Height of right subtree
+  template<typename N>
+    static void built(N* n, size_t hl, size_t hr) {
+      avl_policy::built(n, hl, hr);
+      update(n);
+    }
+  /// @param n Internal node
+  /// @param l Height of the left subtree
+  /// @param r Height of the right subtree
+  /// @return Height of \c n, -1 if it breaks the AVL checks or its largest
+  ///         end point is not that of its entry and children
+  ///
+  /// The children were verified first, so this checks every subtree.
+  template<typename N>
+    static long verify(const N* n, long l, long r) {
+      const Key* h = &n->entry().second.first;
+      if(n->left->is_internal() && *h < n->left->high) h = &n->left->high;
+      if(n->right->is_internal() && *h < n->right->high) h = &n->right->high;
+      return *h < n->high || n->high < *h ? -1 : avl_policy::verify(n, l, r);
+    }
+
+  /// @brief Recompute the largest end point of a node from its children
+  /// @param n Internal node
+  template<typename N>
+    static void update(N* n) {
+      const Key* h = &n->entry().second.first;
+      if(n->left->is_internal() && *h < n->left->high) h = &n->left->high;
+      if(n->right->is_internal() && *h < n->right->high) h = &n->right->high;
+      n->high = *h;
+    }
+  /// @brief Recompute the largest end points from a node up to the top
+  /// @param n Node, the sentinel for none
+  template<typename N>
+    static void update_path(N* n) {
+      for(; !n->is_root(); n = n->get_parent())
+        update(n);
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Ordered map of closed intervals [start, end] keyed by their start,
+///        answering which intervals overlap a range or contain a point
+/// @ingroup MySTL
+/// @tparam Key End point type
+/// @tparam T Value type
+///
+/// Entries are (start, (end, value)) in an AVL tree whose nodes also cache the
+/// largest end in their subtree. A query skips every subtree whose largest
+/// end falls before the range and every right subtree past it, visiting
+/// O(log n + k log(n/k)) nodes for k results. Starts are unique as in a map.
+///
+/// The end of an entry must not be changed through an iterator; insert the
+/// start again instead, which updates the cached ends.
+////////////////////////////////////////////////////////////////////////////////
+template<typename Key, typename T>
+class interval_map :
+  private map<Key, std::pair<Key, T>, 0, false, interval_policy<Key>> {
+
+  typedef map<Key, std::pair<Key, T>, 0, false, interval_policy<Key>>
+    base;                           ///< Underlying map
+  typedef typename base::node node; ///< Tree node
+
+  public:
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Types
+    /// @{
+
+    typedef typename base::key_type key_type;       ///< Start type
+    typedef typename base::mapped_type mapped_type; ///< (End, Value) pair
+    typedef typename base::value_type value_type;   ///< (Start, (End, Value))
+    typedef typename base::iterator iterator;       ///< Iterator
+    typedef typename base::const_iterator
+      const_iterator;                               ///< Const iterator
+    typedef typename base::reverse_iterator
+      reverse_iterator;                             ///< Reverse iterator
+    typedef typename base::const_reverse_iterator
+      const_reverse_iterator;                       ///< Const reverse iterator
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Inherited from map
+    /// @{
+
+    using base::begin;
+    using base::end;
+    using base::rbegin;
+    using base::rend;
+    using base::cbegin;
+    using base::cend;
+    using base::crbegin;
+    using base::crend;
+    using base::size;
+    using base::empty;
+    using base::height;
+    using base::memory_usage;
+    using base::find;
+    using base::count;
+    using base::erase;
+    using base::clear;
+    using base::balanced;
+    using base::valid;
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Modifiers
+    /// @{
+
+    /// @brief Insert an interval, or replace the end and value of the interval
+    ///        with the same start
+    /// @param lo Start
+    /// @param hi End, not less than \c lo
+    /// @param v Value
+    /// @return pair of iterator to the entry and bool, true if it was new
+    std::pair<iterator, bool> insert(const Key& lo, const Key& hi, const T& v) {
+      std::pair<node*, bool> n =
+        base::inserter(value_type(lo, mapped_type(hi, v)));
+      if(n.second)
+        base::rebalance_insert(n.first);
+      else {
+        n.first->entry().second = mapped_type(hi, v);
+        interval_policy<Key>::update_path(n.first);
+      }
+      return std::make_pair(iterator(n.first), n.second);
+    }
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Operations
+    /// @{
+
+    /// @brief Find every interval overlapping a closed range
+    /// @tparam OutputIt Output iterator accepting iterator
+    /// @param lo Start of the range
+    /// @param hi End of the range
+    /// @param out Destination, receives the intervals in order of start
+    /// @return Output iterator past the last written result
+    template<typename OutputIt>
+    OutputIt overlapping(const Key& lo, const Key& hi, OutputIt out) {
+      return collect<iterator>(base::root->left, lo, hi, out);
+    }
+
+    /// @brief Find every interval overlapping a closed range
+    /// @tparam OutputIt Output iterator accepting const_iterator
+    /// @param lo Start of the range
+    /// @param hi End of the range
+    /// @param out Destination, receives the intervals in order of start
+    /// @return Output iterator past the last written result
+    template<typename OutputIt>
+    OutputIt overlapping(const Key& lo, const Key& hi, OutputIt out) const {
+      return collect<const_iterator>(base::root->left, lo, hi, out);
+    }
+
+    /// @brief Find every interval containing a point
+    /// @tparam OutputIt Output iterator accepting iterator
+    /// @param p Point
+    /// @param out Destination, receives the intervals in order of start
+    /// @return Output iterator past the last written result
+    template<typename OutputIt>
+    OutputIt stabbing(const Key& p, OutputIt out) {
+      return overlapping(p, p, out);
+    }
+
+    /// @brief Find every interval containing a point
+    /// @tparam OutputIt Output iterator accepting const_iterator
+    /// @param p Point
+    /// @param out Destination, receives the intervals in order of start
+    /// @return Output iterator past the last written result
+    template<typename OutputIt>
+    OutputIt stabbing(const Key& p, OutputIt out) const {
+      return overlapping(p, p, out);
+    }
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+  private:
+
+    /// @brief Recursive step of overlapping
+    /// @tparam It Iterator type written to \c out
+    /// @tparam OutputIt Output iterator
+    /// @param v Subtree root
+    /// @param lo Start of the range
+    /// @param hi End of the range
+    /// @param out Destination
+    /// @return Output iterator past the last written result
+    template<typename It, typename OutputIt>
+    static OutputIt collect(node* v, const Key& lo, const Key& hi,
+        OutputIt out) {
+      if(v->is_external() || v->high < lo) return out;
+      out = collect<It>(v->left, lo, hi, out);
+      if(hi < v->key()) return out;
+      if(!(v->entry().second.first < lo)) {
+        *out = It(v);
+        ++out;
+      }
+      return collect<It>(v->right, lo, hi, out);
+    }
+};
+
+}
+
+#endif
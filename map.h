@@ -5,30 +5,581 @@
 #ifndef _MAP_H_
 #define _MAP_H_
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
 #include <iostream>
 #include <iterator>
+#include <new>
 #include <stdexcept>
+#include <string>
+#include <thread>
 #include <type_traits>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 namespace mystl {
 
+#ifdef MYSTL_COUNT_ROTATIONS
+/// @return Number of tree rotations performed by the calling thread, only
+///         counted when \c MYSTL_COUNT_ROTATIONS is defined before inclusion
+inline size_t& rotation_count() {
+  static thread_local size_t c = 0;
+  return c;
+}
+#endif
+
+/// @brief Three-way comparison of keys
+/// @tparam K Key type
+/// @param a Key
+/// @param b Key
+/// @param lcp Length of a prefix known to be shared, which string key
+///        overloads extend to the full common prefix
+/// @return Negative, zero or positive as \c a is less than, equal to or
+///         greater than \c b
+template<typename K>
+int compare_keys(const K& a, const K& b, size_t& lcp) {
+  (void)lcp;
+  return a < b ? -1 : b < a ? 1 : 0;
+}
+
+/// @brief Three-way comparison of byte strings, skipping a shared prefix
+/// @param a First string
+/// @param na Length of \c a
+/// @param b Second string
+/// @param nb Length of \c b
+/// @param lcp Length of a prefix known to be shared, set to the full common
+///        prefix length
+/// @return Negative, zero or positive in the order of \c std::string
+inline int compare_bytes(const char* a, size_t na, const char* b, size_t nb,
+    size_t& lcp) {
+  size_t n = na < nb ? na : nb;
+  size_t i = lcp;
+  while(i < n && a[i] == b[i]) ++i;
+  lcp = i;
+  if(i == n) return na < nb ? -1 : na > nb ? 1 : 0;
+  return (unsigned char)a[i] < (unsigned char)b[i] ? -1 : 1;
+}
+
+/// @brief Three-way comparison of strings, skipping a shared prefix
+/// @param a Key
+/// @param b Key
+/// @param lcp Length of a prefix known to be shared, set to the full common
+///        prefix length
+/// @return Negative, zero or positive as \c a is less than, equal to or
+///         greater than \c b
+inline int compare_keys(const std::string& a, const std::string& b,
+    size_t& lcp) {
+  return compare_bytes(a.data(), a.size(), b.data(), b.size(), lcp);
+}
+
+/// @brief Let a newly inserted key share storage with the key next to it,
+///        which string key types may overload. Does nothing by default.
+/// @tparam K Key type
+template<typename K>
+void share_prefix(const K&, const K&) {}
+
+/// @tparam K Key type
+/// @return Heap bytes a key holds outside its node, which key types owning
+///         memory overload. 0 by default.
+template<typename K>
+size_t key_bytes(const K&) {return 0;}
+
+/// @param s Key
+/// @return Capacity of the buffer of \c s, 0 while it fits in the object
+inline size_t key_bytes(const std::string& s) {
+  const char* d = s.data();
+  const char* o = reinterpret_cast<const char*>(&s);
+  return d >= o && d < o + sizeof(s) ? 0 : s.capacity() + 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Balancing policy keeping the tree of a map an AVL tree (the default)
+/// @ingroup MySTL
+///
+/// A balancing policy supplies static hooks that map calls with its node type
+/// \c N, plus a \c node_base that every node derives from for per-node data.
+/// The hooks are not called in bulk mode.
+////////////////////////////////////////////////////////////////////////////////
+struct avl_policy {
+  /// @brief No per-node data, the balance factor lives in the parent link
+  struct node_base {};
+  /// @brief Balance factors give the height in O(log n)
+  static constexpr bool tracks_height = true;
+  /// @brief Erase unlinks nodes at once, see lazy_policy
+  static constexpr size_t tombstone_percent = 0;
+
+  /// @brief Restore balance after linking a new node
+  /// @param n New node
+  template<typename N>
+    static void inserted(N* n) {n->rebalance_insert();}
+  /// @brief Restore balance after unlinking a node
+  /// @param s Node promoted into the place of the removed one
+  template<typename N>
+    static void erased(N* s) {s->rebalance();}
+  /// @brief Nothing to do on lookup
+  template<typename N>
+    static void accessed(N*) {}
+  /// @brief Nothing to do after a rotation
+  template<typename N>
+    static void rotated(N*) {}
+  /// @brief Take over balancing data
+  /// @param c Node taking the place of \c s
+  /// @param s Source node
+  template<typename N>
+    static void copied(N* c, const N& s) {c->set_balance(s.get_balance());}
+  /// @brief Set balancing data of a node whose subtrees were just built
+  /// @param n Node
+  /// @param hl Height of left subtree
+  /// @param hr Height of right subtree
+  template<typename N>
+    static void built(N* n, size_t hl, size_t hr) {
+      n->set_balance(int(hr) - int(hl));
+    }
+  /// @param t Top of the tree
+  /// @return Does the top of the tree satisfy the AVL property?
+  template<typename N>
+    static bool balanced(const N* t) {return t->is_external() || t->balanced();}
+  /// @param n Internal node
+  /// @param l Height of the left subtree
+  /// @param r Height of the right subtree
+  /// @return Height of \c n, -1 if its balance factor is not the true height
+  ///         difference or exceeds 1
+  template<typename N>
+    static long verify(const N* n, long l, long r) {
+      return r - l >= -1 && r - l <= 1 && r - l == n->get_balance() ?
+        1 + (l > r ? l : r) : -1;
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Balancing policy making the tree of a map a splay tree
+/// @ingroup MySTL
+///
+/// Every insert and every non-const lookup rotates the node to the top, so
+/// frequently used keys stay near the root. Costs are O(log n) amortized, but a
+/// single operation can take O(n) and the tree can become a path (e.g., after
+/// sorted inserts). find_sorted and copies walk such paths without recursion.
+/// Const lookups do not splay.
+////////////////////////////////////////////////////////////////////////////////
+struct splay_policy {
+  /// @brief No per-node data
+  struct node_base {};
+  /// @brief The height needs a full traversal
+  static constexpr bool tracks_height = false;
+  /// @brief Erase unlinks nodes at once, see lazy_policy
+  static constexpr size_t tombstone_percent = 0;
+
+  /// @brief Splay a new node
+  /// @param n New node
+  template<typename N>
+    static void inserted(N* n) {splay(n);}
+  /// @brief Splay the parent of a removed node
+  /// @param s Node promoted into the place of the removed one
+  template<typename N>
+    static void erased(N* s) {
+      N* x = s->is_internal() ? s : s->get_parent();
+      if(!x->is_root()) splay(x);
+    }
+  /// @brief Splay a node found by a lookup
+  /// @param n Node
+  template<typename N>
+    static void accessed(N* n) {splay(n);}
+  /// @brief Nothing to do after a rotation
+  template<typename N>
+    static void rotated(N*) {}
+  /// @brief No data to take over
+  template<typename N>
+    static void copied(N*, const N&) {}
+  /// @brief No data to set
+  template<typename N>
+    static void built(N*, size_t, size_t) {}
+  /// @return Always true, splay trees have no shape invariant
+  template<typename N>
+    static bool balanced(const N*) {return true;}
+  /// @return Always 0, splay trees have no shape invariant
+  template<typename N>
+    static long verify(const N*, long, long) {return 0;}
+
+  /// @brief Rotate a node up to the top of the tree
+  /// @param x Node
+  template<typename N>
+    static void splay(N* x) {
+      while(!x->get_parent()->is_root()) {
+        N* p = x->get_parent();
+        N* g = p->get_parent();
+        bool xl = x == p->left;
+        if(g->is_root()) {
+          if(xl) p->rotate_right();
+          else p->rotate_left();
+        }
+        else if(xl == (p == g->left)) {
+          if(xl) {
+            g->rotate_right();
+            p->rotate_right();
+          }
+          else {
+            g->rotate_left();
+            p->rotate_left();
+          }
+        }
+        else if(xl) {
+          p->rotate_right();
+          g->rotate_left();
+        }
+        else {
+          p->rotate_left();
+          g->rotate_right();
+        }
+      }
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Balancing policy making the tree of a map a treap
+/// @ingroup MySTL
+///
+/// Each node draws a random priority when it is created and the tree is kept
+/// a max-heap on priorities, giving expected O(log n) depth with at most two
+/// expected rotations per insert and none per erase.
+////////////////////////////////////////////////////////////////////////////////
+struct treap_policy {
+  /// @brief Heap priority of a node
+  struct node_base {
+    /// @brief Constructor, draws a random priority
+    node_base() : priority(treap_policy::random()) {}
+    uint32_t priority; ///< Heap priority, larger is nearer the root
+  };
+  /// @brief The height needs a full traversal
+  static constexpr bool tracks_height = false;
+  /// @brief Erase unlinks nodes at once, see lazy_policy
+  static constexpr size_t tombstone_percent = 0;
+
+  /// @brief Rotate a new node up until its parent has a larger priority
+  /// @param n New node
+  template<typename N>
+    static void inserted(N* n) {
+      while(!n->get_parent()->is_root() &&
+          n->get_parent()->priority < n->priority) {
+        N* p = n->get_parent();
+        if(n == p->left) p->rotate_right();
+        else p->rotate_left();
+      }
+    }
+  /// @brief Nothing to do, the removed node is replaced by its only internal
+  ///        subtree whose priorities are all lower than its parent's
+  template<typename N>
+    static void erased(N*) {}
+  /// @brief Nothing to do on lookup
+  template<typename N>
+    static void accessed(N*) {}
+  /// @brief Nothing to do after a rotation
+  template<typename N>
+    static void rotated(N*) {}
+  /// @brief Take over the priority
+  /// @param c Node taking the place of \c s
+  /// @param s Source node
+  template<typename N>
+    static void copied(N* c, const N& s) {c->priority = s.priority;}
+  /// @brief Restore heap order below a node whose subtrees were just built,
+  ///        by sifting its priority down
+  /// @param n Node
+  template<typename N>
+    static void built(N* n, size_t, size_t) {
+      for(N* v = n;;) {
+        N* c = v->right->is_internal() && (v->left->is_external() ||
+            v->left->priority < v->right->priority) ? v->right : v->left;
+        if(c->is_external() || !(v->priority < c->priority)) return;
+        std::swap(v->priority, c->priority);
+        v = c;
+      }
+    }
+  /// @param t Top of the tree
+  /// @return Does the top of the tree satisfy the heap property?
+  template<typename N>
+    static bool balanced(const N* t) {
+      return t->is_external() ||
+        ((t->left->is_external() || !(t->priority < t->left->priority)) &&
+         (t->right->is_external() || !(t->priority < t->right->priority)));
+    }
+  /// @param n Internal node
+  /// @return 0, -1 if \c n breaks heap order with a child
+  template<typename N>
+    static long verify(const N* n, long, long) {
+      return balanced(n) ? 0 : -1;
+    }
+
+  /// @return Next pseudorandom priority of the calling thread
+  static uint32_t random() {
+    static thread_local uint32_t x = 2463534242u;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Balancing policy making the tree of a map a weak AVL (WAVL) tree
+/// @ingroup MySTL
+///
+/// Every node has a rank, external leaves rank 0, and a child's rank is 1 or
+/// 2 below its parent's, with no internal leaf of rank 2. Only the parity of
+/// the rank is stored, in the bits AVL uses for the balance factor. Without
+/// erases the tree is exactly an AVL tree; erases only demote ranks, so the
+/// height stays within 2 log2(n) and every update does at most two rotations
+/// and O(1) amortized rank changes, stopping as soon as the ranks are valid.
+////////////////////////////////////////////////////////////////////////////////
+struct wavl_policy {
+  /// @brief No per-node data, the rank parity lives in the parent link
+  struct node_base {};
+  /// @brief The height needs a full traversal
+  static constexpr bool tracks_height = false;
+  /// @brief Erase unlinks nodes at once, see lazy_policy
+  static constexpr size_t tombstone_percent = 0;
+
+  /// @brief Give a new node rank 1 and promote or rotate up the tree
+  /// @param n New node
+  template<typename N>
+    static void inserted(N* n) {
+      n->set_balance(1);
+      for(N* x = n;;) {
+        N* p = x->get_parent();
+        // stop unless x now has rank difference 0
+        if(p->is_root() || parity(p) != parity(x)) return;
+        N* s = x == p->left ? p->right : p->left;
+        if(parity(s) != parity(p)) {
+          flip(p);
+          x = p;
+          continue;
+        }
+        N* y = x == p->left ? x->right : x->left;
+        if(parity(y) == parity(x)) {
+          if(x == p->left) p->rotate_right();
+          else p->rotate_left();
+          flip(p);
+        }
+        else {
+          if(x == p->left) {
+            x->rotate_left();
+            p->rotate_right();
+          }
+          else {
+            x->rotate_right();
+            p->rotate_left();
+          }
+          flip(y);
+          flip(x);
+          flip(p);
+        }
+        return;
+      }
+    }
+  /// @brief Demote or rotate up the tree after unlinking a node
+  /// @param s Node promoted into the place of the removed one, whose rank
+  ///        difference is now 2 or 3
+  template<typename N>
+    static void erased(N* s) {
+      N* x = s;
+      N* p = x->get_parent();
+      if(p->is_root()) return;
+      if(p->left->is_external() && p->right->is_external()) {
+        // a leaf of rank 2 is demoted to rank 1
+        if(parity(p)) return;
+        flip(p);
+        x = p;
+        p = x->get_parent();
+      }
+      // rank difference of x is 2 or 3, odd means 3
+      while(!p->is_root() && parity(x) != parity(p)) {
+        bool xl = x == p->left;
+        N* y = xl ? p->right : p->left;
+        if(parity(y) == parity(p)) {
+          flip(p);
+        }
+        else {
+          N* v = xl ? y->left : y->right;
+          N* w = xl ? y->right : y->left;
+          if(parity(v) == parity(y) && parity(w) == parity(y)) {
+            flip(p);
+            flip(y);
+          }
+          else {
+            if(parity(w) != parity(y)) {
+              if(xl) p->rotate_left();
+              else p->rotate_right();
+              flip(y);
+              flip(p);
+              if(p->left->is_external() && p->right->is_external()) flip(p);
+            }
+            else {
+              if(xl) {
+                y->rotate_right();
+                p->rotate_left();
+              }
+              else {
+                y->rotate_left();
+                p->rotate_right();
+              }
+              flip(y);
+            }
+            return;
+          }
+        }
+        x = p;
+        p = x->get_parent();
+      }
+    }
+  /// @brief Nothing to do on lookup
+  template<typename N>
+    static void accessed(N*) {}
+  /// @brief Nothing to do after a rotation
+  template<typename N>
+    static void rotated(N*) {}
+  /// @brief Take over the rank parity
+  /// @param c Node taking the place of \c s
+  /// @param s Source node
+  template<typename N>
+    static void copied(N* c, const N& s) {c->set_balance(s.get_balance());}
+  /// @brief Set the rank of a node whose subtrees were just built to its
+  ///        height
+  /// @param n Node
+  /// @param hl Height of left subtree
+  /// @param hr Height of right subtree
+  template<typename N>
+    static void built(N* n, size_t hl, size_t hr) {
+      n->set_balance(int((1 + (hl > hr ? hl : hr)) % 2));
+    }
+  /// @param t Top of the tree
+  /// @return Does the whole tree satisfy the rank rule? Takes O(n).
+  template<typename N>
+    static bool balanced(const N* t) {return rank(t) >= 0;}
+
+  /// @param n Node
+  /// @return Parity of the rank of \c n
+  template<typename N>
+    static bool parity(const N* n) {return n->get_balance() != 0;}
+  /// @brief Promote or demote a node by one rank
+  /// @param n Node
+  template<typename N>
+    static void flip(N* n) {n->set_balance(parity(n) ? 0 : 1);}
+  /// @param n Internal node
+  /// @param l Rank of the left child
+  /// @param r Rank of the right child
+  /// @return Rank of \c n recovered from the parities, -1 if the rank
+  ///         differences to its children, each 1 or 2 by parity, disagree,
+  ///         an external child has a nonzero rank, or \c n is a 2,2 leaf
+  template<typename N>
+    static long verify(const N* n, long l, long r) {
+      long rl = l + (parity(n->left) != parity(n) ? 1 : 2);
+      long rr = r + (parity(n->right) != parity(n) ? 1 : 2);
+      return rl == rr && (l > 0 || r > 0 || rl == 1) &&
+        !(n->left->is_external() && parity(n->left)) &&
+        !(n->right->is_external() && parity(n->right)) ? rl : -1;
+    }
+  /// @param n Subtree root
+  /// @return Rank of \c n recovered from the parities, -1 if the subtree
+  ///         breaks the rank rule
+  template<typename N>
+    static long rank(const N* n) {
+      if(n->is_external()) return parity(n) ? -1 : 0;
+      long l = rank(n->left);
+      long r = rank(n->right);
+      return l < 0 || r < 0 ? -1 : verify(n, l, r);
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Balancing policy adapter making erase leave tombstones
+/// @ingroup MySTL
+/// @tparam Base Balancing policy of the tree
+/// @tparam Percent Share of the tree nodes, in percent, that tombstones may
+///         take before an erase rebuilds the tree without them
+///
+/// An erase only marks its node, which lookups, iterators and size() then
+/// skip, and inserting the key again revives it in place. Once tombstones
+/// pass \c Percent of the nodes the tree is rebuilt perfectly balanced in
+/// O(n), so an erase costs one descent amortized. The values of tombstones
+/// are destroyed at the rebuild. Nodes are aligned to 16 bytes to free a bit
+/// of the parent link for the mark. Small-size mode still erases at once.
+////////////////////////////////////////////////////////////////////////////////
+template<typename Base = avl_policy, size_t Percent = 25>
+struct lazy_policy : Base {
+  static_assert(Percent > 0 && Percent < 100,
+      "lazy_policy needs a percent between 0 and 100");
+
+  /// @brief Erase leaves tombstones up to this percent of the nodes
+  static constexpr size_t tombstone_percent = Percent;
+};
+
+template<typename Key, typename T>
+  class interval_map; ///< Forward declare interval map, a friend of map
+template<typename Key, typename Value, typename Clock>
+  class cache_map;    ///< Forward declare cache map, a friend of map
+
 ////////////////////////////////////////////////////////////////////////////////
 /// @brief Map ADT based on C++ map implemented with binary search tree
 /// @ingroup MySTL
 /// @tparam Key Key type
 /// @tparam Value Value type
+/// @tparam SmallSize Number of entries stored inline before switching to the
+///         binary search tree, 0 (the default) always uses the tree
+/// @tparam Indexed Keep a hashed side index from key to node, requires
+///         \c std::hash<Key>
+/// @tparam Balance Balancing policy: avl_policy (the default), wavl_policy,
+///         splay_policy or treap_policy
+/// @tparam OutOfLine Keep each entry in its own allocation, nodes holding
+///         only a copy of the key
 ///
 /// Assumes the following: There is always enough memory for allocations (not a
 /// good assumption, just good enough for our purposes); Functions not
 /// well-defined on an empty container will exhibit undefined behavior.
+///
+/// With a nonzero \c SmallSize the map starts in a small-size mode: entries
+/// live in a sorted array of nodes inside the map object itself and are
+/// searched linearly, so small maps perform no heap allocation at all. The
+/// first insert beyond \c SmallSize promotes the entries into the AVL tree,
+/// which is kept until clear(). As with any sorted array, inserts and erases
+/// in small-size mode invalidate iterators, as does promotion.
+///
+/// Copies lay their nodes out in inorder sequence in large slabs, and copy and
+/// destruction of large trees are split across threads. A slab is only given
+/// back once every node in it is gone, so erasing most of a copied map keeps
+/// nearly all of its slabs: the slots it frees are kept as spares and reused
+/// by later inserts, and compact() moves the survivors into fresh slabs sized
+/// to them. memory_usage() reports the slabs in full.
+///
+/// With \c Indexed the tree mode also keeps an unordered map from each key to
+/// its node, so point lookups (find, count, at, and operator[] or insert of an
+/// existing key) take O(1) expected time instead of an O(log n) descent.
+/// Iteration and ordered operations still use the tree. The index costs
+/// memory per entry and a hash update on every insert and erase.
+///
+/// The balancing policy decides only how the tree is reshaped after inserts,
+/// erases and lookups; nodes, iterators and the whole interface are shared.
+///
+/// With \c OutOfLine nodes hold the key, links and balance data plus a
+/// pointer to the entry, which suits large values: searches walk compact
+/// nodes, external leaves construct no value, and an entry stays at the same
+/// address from insert to erase, so references to it survive erasure of
+/// other keys. Keys are stored twice and each entry costs one more
+/// allocation.
 ////////////////////////////////////////////////////////////////////////////////
-template<typename Key, typename Value>
+template<typename Key, typename Value, size_t SmallSize = 0,
+  bool Indexed = false, typename Balance = avl_policy, bool OutOfLine = false>
 class map {
 
   struct node;           ///< Forward declare node class
+  class slab_allocator;  ///< Forward declare node memory allocator
   template<typename>
     class map_iterator; ///< Forward declare iterator class
+  template<typename, typename>
+    friend class interval_map; ///< Walks the tree for overlap queries
+  template<typename, typename, typename>
+    friend class cache_map;    ///< Removes nodes without moving values
 
   public:
 
@@ -49,6 +600,115 @@ class map {
     typedef std::reverse_iterator<const_iterator>
       const_reverse_iterator;  ///< Const reverse bidirectional iterator
 
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Breakdown of the memory held by a map, in bytes
+    ///
+    /// Payload is the shallow size of the stored entries; memory owned by the
+    /// values themselves (e.g., string buffers) is not included. Memory owned
+    /// by the keys is counted separately, as reported by key_bytes().
+    /// Allocator overhead is an estimate assuming a glibc-like malloc with an
+    /// 8 byte header and 16 byte granularity.
+    ////////////////////////////////////////////////////////////////////////////
+    struct memory_stats {
+      size_t internal_count; ///< Number of internal (entry) nodes
+      size_t external_count; ///< Number of external leaves and sentinels
+      size_t internal_nodes; ///< Link and balance metadata of internal nodes
+      size_t external_nodes; ///< Full size of external leaves and sentinels
+      size_t payload;        ///< Key/value entries of internal nodes
+      size_t allocator_overhead; ///< Estimated malloc headers and padding
+      size_t index;          ///< Estimated hashed side index, 0 if disabled
+      size_t keys;           ///< Heap bytes held by the keys of entries
+      /// @return Total footprint
+      size_t total() const {
+        return internal_nodes + external_nodes + payload + allocator_overhead +
+          index + keys;
+      }
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Owning handle to a single extracted entry
+    ///
+    /// The handle owns the entry's node together with one external leaf, which
+    /// is all that is needed to link the node back into a tree without any
+    /// allocation or copy of the entry.
+    ////////////////////////////////////////////////////////////////////////////
+    class node_type {
+      public:
+        /// @brief Construct an empty handle
+        node_type() : n(nullptr) {}
+        /// @brief Move construction
+        /// @param h Other handle, left empty
+        node_type(node_type&& h) : n(h.n) {h.n = nullptr;}
+        /// @brief Move assignment
+        /// @param h Other handle, left empty
+        /// @return Reference to self
+        node_type& operator=(node_type&& h) {
+          if(this != &h) {
+            dispose();
+            n = h.n;
+            h.n = nullptr;
+          }
+          return *this;
+        }
+        /// @brief Destructor, frees an entry that was never reinserted
+        ~node_type() {dispose();}
+
+        /// @return Does the handle hold no entry?
+        bool empty() const {return n == nullptr;}
+        /// @return Does the handle hold an entry?
+        explicit operator bool() const {return n != nullptr;}
+        /// @return Key of the held entry, may be modified before reinsertion
+        Key& key() const {return const_cast<Key&>(n->entry().first);}
+        /// @return Value of the held entry
+        Value& mapped() const {return n->entry().second;}
+
+      private:
+        /// @brief Take ownership of a detached node
+        /// @param v Node with its carried leaf as left child
+        explicit node_type(node* v) : n(v) {}
+
+        /// @brief Free the held node and its carried leaf
+        void dispose() {
+          if(n) {
+            node::destroy(n->left);
+            node::destroy(n);
+          }
+        }
+
+        node* n; ///< Owned node, nullptr when empty
+
+        friend class map;
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Result of inserting a node handle
+    ////////////////////////////////////////////////////////////////////////////
+    struct insert_return_type {
+      iterator position; ///< Inserted or already existing element
+      bool inserted;     ///< Was the entry inserted?
+      node_type node;    ///< The handle back if the key existed, else empty
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Keeps a map in bulk mode for the lifetime of the scope
+    ////////////////////////////////////////////////////////////////////////////
+    class bulk_load_scope {
+      public:
+        /// @brief Constructor, enters bulk mode
+        /// @param m Map being loaded
+        explicit bulk_load_scope(map& m) : m(m) {m.begin_bulk();}
+        /// @brief Destructor, leaves bulk mode
+        ~bulk_load_scope() {m.end_bulk();}
+
+        /// @brief Copy construction - Deleted
+        bulk_load_scope(const bulk_load_scope&) = delete;
+        /// @brief Copy assignment - Deleted
+        bulk_load_scope& operator=(const bulk_load_scope&) = delete;
+
+      private:
+        map& m; ///< Map being loaded
+    };
+
     /// @}
     ////////////////////////////////////////////////////////////////////////////
 
@@ -57,16 +717,18 @@ class map {
     /// @{
 
     /// @brief Constructor
-    map() : root(new node()), sz(0) {
-      root->expand();
+    map() : root(nullptr), sz(0), tombs(0), bulk(0), finger(nullptr) {
+      init();
     }
     /// @brief Copy constructor
     /// @param m Other map
-    map(const map& m) : root(new node(*m.root)), sz(m.sz) {
+    map(const map& m) :
+      root(nullptr), sz(0), tombs(0), bulk(0), finger(nullptr) {
+      copy_from(m);
     }
     /// @brief Destructor
     ~map() {
-      delete root;
+      release();
     }
 
     /// @brief Copy assignment
@@ -74,9 +736,8 @@ class map {
     /// @return Reference to self
     map& operator=(const map& m) {
       if(this != &m) {
-        delete root;
-        root = new node(*m.root);
-        sz = m.sz;
+        release();
+        copy_from(m);
       }
       return *this;
     }
@@ -89,21 +750,21 @@ class map {
     /// @{
 
     /// @return Iterator to oeginning
-    iterator begin() {return iterator(root->leftmost());}
+    iterator begin() {return iterator(first());}
     /// @return Iterator to end
     iterator end() {return iterator(root);}
     /// @return Iterator to reverse beginning
     reverse_iterator rbegin() {return reverse_iterator(root);}
     /// @return Iterator to reverse end
-    reverse_iterator rend() {return reverse_iterator(root->leftmost());}
+    reverse_iterator rend() {return reverse_iterator(first());}
     /// @return Iterator to beginning
-    const_iterator cbegin() const {return const_iterator(root->leftmost());}
+    const_iterator cbegin() const {return const_iterator(first());}
     /// @return Iterator to end
     const_iterator cend() const {return const_iterator(root);}
     /// @return Iterator to reverse beginning
     const_reverse_iterator crbegin() const {return const_reverse_iterator(root);}
     /// @return Iterator to reverse end
-    const_reverse_iterator crend() const {return const_reverse_iterator(root->leftmost());}
+    const_reverse_iterator crend() const {return const_reverse_iterator(first());}
 
     /// @}
     ////////////////////////////////////////////////////////////////////////////
@@ -117,6 +778,86 @@ class map {
     /// @return Does the map contain anything?
     bool empty() const {return sz == 0;}
 
+    /// @return Height of the tree, 0 for an empty map or in small-size mode
+    ///
+    /// An AVL tree of n entries never exceeds 1.44 log2(n+2) in height, and
+    /// its height is found in O(log n). Other policies traverse the tree.
+    size_t height() const {
+      if(is_small()) return 0;
+      return Balance::tracks_height ? root->left->get_height() :
+        depth_histogram().size();
+    }
+
+    /// @return Number of entries at each depth, the root entry is depth 0.
+    ///         Empty in small-size mode.
+    std::vector<size_t> depth_histogram() const {
+      std::vector<size_t> hist;
+      if(is_small()) return hist;
+      std::vector<std::pair<const node*, size_t>> stack;
+      stack.push_back(std::make_pair(root->left, size_t(0)));
+      while(!stack.empty()) {
+        const node* n = stack.back().first;
+        size_t d = stack.back().second;
+        stack.pop_back();
+        if(n->is_external()) continue;
+        if(hist.size() <= d) hist.resize(d + 1, 0);
+        ++hist[d];
+        stack.push_back(std::make_pair(n->left, d + 1));
+        stack.push_back(std::make_pair(n->right, d + 1));
+      }
+      return hist;
+    }
+
+    /// @return Breakdown of the memory held by the map
+    ///
+    /// Every entry owns one internal node, and expand() leaves n + 1 external
+    /// nodes beneath them, plus the root sentinel and its unused right leaf.
+    /// Tombstones of lazy erase count as internal nodes without payload.
+    /// In small-size mode entries are held inline without any external nodes
+    /// or allocations. Out of line entries are payload, and the key copied
+    /// into their node is metadata.
+    ///
+    /// Nodes made by new cost their malloc chunk. Nodes in slabs (those of
+    /// copies and compact()) are counted through their slabs instead: every
+    /// slab holding a node or a spare slot of the map counts in full, with
+    /// its header, unused and freed slots as allocator overhead. Finding the
+    /// slabs walks the tree in O(n). A slab shared with another map, through
+    /// node handles, counts in full for both.
+    memory_stats memory_usage() const {
+      memory_stats m;
+      m.keys = 0;
+      for(const_iterator j = cbegin(); j != cend(); ++j)
+        m.keys += key_bytes(j->first);
+      const size_t inline_entry = OutOfLine ? 0 : sizeof(value_type);
+      const size_t boxes = OutOfLine ? sz + tombs : 0;
+      if(is_small()) {
+        m.internal_count = sz;
+        m.external_count = 0;
+        m.internal_nodes = sz * (sizeof(node) - inline_entry);
+        m.external_nodes = 0;
+        m.payload = sz * sizeof(value_type);
+        m.allocator_overhead =
+          boxes * (malloc_chunk(sizeof(value_type)) - sizeof(value_type));
+        m.index = 0;
+        return m;
+      }
+      m.internal_count = sz + tombs;
+      m.external_count = sz + tombs + 3;
+      m.internal_nodes = sz * (sizeof(node) - inline_entry) +
+        tombs * (sizeof(node) + sizeof(value_type) - inline_entry);
+      m.external_nodes = m.external_count * sizeof(node);
+      m.payload = sz * sizeof(value_type);
+      std::vector<std::uintptr_t> slabs;
+      size_t heap = slab_census(slabs);
+      size_t in_slabs = m.internal_count + m.external_count - heap;
+      m.allocator_overhead =
+        heap * (malloc_chunk(sizeof(node)) - sizeof(node)) +
+        slabs.size() * slab_allocator::bytes() - in_slabs * sizeof(node) +
+        boxes * (malloc_chunk(sizeof(value_type)) - sizeof(value_type));
+      m.index = index.memory_usage();
+      return m;
+    }
+
     /// @}
     ////////////////////////////////////////////////////////////////////////////
 
@@ -135,8 +876,8 @@ class map {
     /// (constructed through default construction)
     Value& operator[](const Key& k) {
       std::pair<node*, bool> a =  inserter(std::make_pair(k, Value()));
-      a.first->left->rebalance();
-      return a.first->value.second;
+      if(a.second && !is_small()) rebalance_insert(a.first);
+      return a.first->entry().second;
     }
 
     /// @param k Input key
@@ -184,9 +925,11 @@ class map {
     /// store unique elements, so if the element existed already it is returned.
     std::pair<iterator, bool> insert(const value_type& v) {
       std::pair<node*,bool> n = inserter(v);		// inserts the node if it does not exist, or finds where it is if it does
-      if(n.second == true) return n;			// if the node did not exist, just return the positon/boolean pair
-      n.first->value.second = v.second;			// if the node did exist, change its value to match the new value
-      n.first->rebalance();
+      if(n.second == true) {				// if the node did not exist, restore balance and return the positon/boolean pair
+        if(!is_small()) rebalance_insert(n.first);
+        return n;
+      }
+      n.first->entry().second = v.second;			// if the node did exist, change its value to match the new value
       return n;
     }
     /// @brief Remove element at specified position
@@ -194,28 +937,156 @@ class map {
     /// @return Position of new location of element which was after eliminated
     ///         one
     iterator erase(const_iterator position) {
-      /// @todo Implement erase. Utilize eraser helper.
-      node* v = position.n->inorder_next();
-      eraser(position.n);
-      v->rebalance();
+      if(is_small()) {
+        size_t i = position.n - store.slot(0);
+        small_eraser(i);
+        return iterator(i < sz ? store.slot(i) : root);
+      }
+      node* n = position.n;
+      if(Balance::tombstone_percent) {
+        iterator next(n);
+        ++next;
+        bury(n);
+        return next;
+      }
+      // with two internal children the successor's value moves into n
+      node* v = n->left->is_internal() && n->right->is_internal() ?
+        n : n->inorder_next();
+      rebalance(eraser(n));
       return v;
     }
     /// @brief Remove element at specified position
     /// @param k Key
     /// @return Number of elements removed (in this case it is at most 1)
     size_t erase(const Key& k) {
-      /// @todo Implement erase. Utilize finder and eraser helpers.
+      if(is_small()) {
+        size_t i;
+        if(!small_finder(k, i)) return 0;
+        small_eraser(i);
+        return 1;
+      }
       node* n = finder(k);
+      if(!is_live(n)) return 0;
+      if(Balance::tombstone_percent) {
+        bury(n);
+        return 1;
+      }
       node* e = eraser(n);
-      e->rebalance();
+      rebalance(e);
       return 1;
     }
+    /// @brief Unlink the element with key \c k and hand over its ownership
+    /// @param k Key
+    /// @return Handle owning the element, empty if \c k is not in the map
+    node_type extract(const Key& k) {
+      iterator i = find(k);
+      if(i == end()) return node_type();
+      return extract(i);
+    }
+    /// @brief Unlink the element at a position and hand over its ownership
+    /// @param position Position
+    /// @return Handle owning the element
+    ///
+    /// The node itself is detached from the tree, never its value: when it
+    /// has two internal children, its inorder successor node is relinked into
+    /// its place. Iterators to other elements remain valid. In small-size
+    /// mode the inline entry is copied into a new node instead.
+    node_type extract(const_iterator position) {
+      if(is_small()) {
+        size_t i = position.n - store.slot(0);
+        node* h = new node(std::move(*position.n));
+        h->left = new node;
+        h->left->set_parent(h);
+        small_eraser(i);
+        return node_type(h);
+      }
+      return node_type(extractor(position.n));
+    }
+    /// @brief Insert the element owned by a node handle
+    /// @param h Node handle, emptied when its element is inserted
+    /// @return Position of the inserted or existing element, whether it was
+    ///         inserted, and the handle back if the key already existed
+    ///
+    /// Ownership of the node moves into the tree without allocation or copy.
+    insert_return_type insert(node_type&& h) {
+      insert_return_type r;
+      if(h.empty()) {
+        r.position = end();
+        r.inserted = false;
+        return r;
+      }
+      std::pair<node*, bool> n = node_inserter(h.n);
+      r.position = iterator(n.first);
+      r.inserted = n.second;
+      if(n.second) h.n = nullptr;
+      else r.node = std::move(h);
+      return r;
+    }
+    /// @brief Move every element of \c m whose key is not in this map into
+    ///        this map
+    /// @param m Other map, keeps the elements whose keys collided
+    ///
+    /// Nodes are relinked from one tree to the other, no entry is copied.
+    void merge(map& m) {
+      if(this == &m) return;
+      if(m.is_small()) {
+        for(size_t i = 0; i < m.sz;) {
+          node* e = m.store.slot(i);
+          if(count(e->key())) ++i;
+          else insert(m.extract(const_iterator(e)));
+        }
+        return;
+      }
+      for(iterator i = m.begin(); i != m.end();) {
+        iterator j = i++;
+        if(!count(j->first))
+          insert(m.extract(j));
+      }
+    }
+    /// @brief Enter bulk mode, calls may nest
+    ///
+    /// In bulk mode inserts and erases are plain binary search tree updates:
+    /// no AVL rebalancing walk and no balance factor maintenance. To keep sorted or
+    /// skewed loads from degenerating, an insert landing deeper than
+    /// log_{3/2}(n) rebuilds the lowest ancestor subtree that is out of
+    /// 2/3 weight balance (as in a scapegoat tree). Lookups and iteration stay
+    /// correct throughout; height() and balanced() are stale until
+    /// end_bulk().
+    void begin_bulk() {++bulk;}
+    /// @brief Leave bulk mode, rebuilding a perfectly balanced tree in O(n)
+    ///        when the outermost call ends
+    void end_bulk() {
+      if(bulk > 0 && --bulk == 0 && !is_small() && root->left->is_internal())
+        rebuild(root->left);
+    }
+    /// @return Is the map in bulk mode?
+    bool in_bulk() const {return bulk > 0;}
+
+    /// @brief Relocate every node into fresh slabs in inorder sequence
+    ///
+    /// Entries are moved, not copied, and the scattered originals are freed,
+    /// so a map fragmented by long churn scans like a freshly built one.
+    /// Invalidates all iterators. Does nothing in small-size mode, where the
+    /// entries are already contiguous.
+    ///
+    /// The old slabs and spare slots are given back, so compacting after
+    /// mass erasure also returns the memory. Later erases leave slots in the
+    /// new slabs that inserts reuse, but a map that mostly shrinks afterwards
+    /// holds on to them until it is compacted again.
+    void compact() {
+      if(is_small()) return;
+      node* r = clone(*this, true);
+      teardown();
+      release_spare();
+      root = r;
+      finger = nullptr;
+      reindex();
+    }
+
     /// @brief Removes all elements
     void clear() noexcept {
-      delete root;
-      root = new node();
-      root->expand();
-      sz = 0;
+      release();
+      init();
     }
 
     ///
@@ -229,18 +1100,125 @@ class map {
     /// @param k Key
     /// @return Iterator to position if found, end() otherwise
     iterator find(const Key& k) {
-      node* v = finder(k);
-      if(v->is_internal()) return iterator(v);
-      else return end();
+      node* v = lookup(k);
+      if(v && !is_small()) touch(v);
+      return v ? iterator(v) : end();
     }
 
     /// @brief Search the container for an element with key \c k
     /// @param k Key
     /// @return Iterator to position if found, cend() otherwise
     const_iterator find(const Key& k) const {			// as above, but const
-      node* v = finder(k);
-      if(v->is_internal()) return const_iterator(v);
-      else return cend();
+      node* v = lookup(k);
+      return v ? const_iterator(v) : cend();
+    }
+
+    /// @brief Search the container for every key in a batch
+    /// @tparam ForwardIt Forward iterator over keys
+    /// @tparam OutputIt Output iterator accepting iterator
+    /// @param first Beginning of keys
+    /// @param last End of keys
+    /// @param out Destination, receives one iterator per key, end() if the key
+    ///        is not found
+    /// @return Output iterator past the last written result
+    ///
+    /// Keys are searched in groups whose descents are interleaved: each step
+    /// prefetches the next node of every lookup in the group before any of
+    /// them is dereferenced, so the cache misses of independent lookups
+    /// overlap instead of serializing.
+    template<typename ForwardIt, typename OutputIt>
+    OutputIt find_many(ForwardIt first, ForwardIt last, OutputIt out) {
+      if(is_small() || Indexed) {
+        for(; first != last; ++first, ++out) *out = find(*first);
+        return out;
+      }
+      ForwardIt keys[batch_size];
+      node* nodes[batch_size];
+      while(first != last) {
+        size_t g = 0;
+        for(; g < batch_size && first != last; ++g, ++first)
+          keys[g] = first;
+        batch_finder(keys, nodes, g);
+        for(size_t i = 0; i < g; ++i, ++out)
+          *out = is_live(nodes[i]) ? iterator(nodes[i]) : end();
+      }
+      return out;
+    }
+
+    /// @brief Search the container for every key in a batch
+    /// @tparam ForwardIt Forward iterator over keys
+    /// @tparam OutputIt Output iterator accepting const_iterator
+    /// @param first Beginning of keys
+    /// @param last End of keys
+    /// @param out Destination, receives one iterator per key, cend() if the
+    ///        key is not found
+    /// @return Output iterator past the last written result
+    template<typename ForwardIt, typename OutputIt>
+    OutputIt find_many(ForwardIt first, ForwardIt last, OutputIt out) const {
+      if(is_small() || Indexed) {
+        for(; first != last; ++first, ++out) *out = find(*first);
+        return out;
+      }
+      ForwardIt keys[batch_size];
+      node* nodes[batch_size];
+      while(first != last) {
+        size_t g = 0;
+        for(; g < batch_size && first != last; ++g, ++first)
+          keys[g] = first;
+        batch_finder(keys, nodes, g);
+        for(size_t i = 0; i < g; ++i, ++out)
+          *out = is_live(nodes[i]) ? const_iterator(nodes[i]) : cend();
+      }
+      return out;
+    }
+
+    /// @brief Search the container for every key in a batch by a single
+    ///        merged traversal of the tree
+    /// @tparam RandomIt Random access iterator over keys
+    /// @tparam OutputIt Output iterator accepting iterator
+    /// @param first Beginning of keys
+    /// @param last End of keys
+    /// @param out Destination, receives one iterator per key in input order,
+    ///        end() if the key is not found
+    /// @return Output iterator past the last written result
+    ///
+    /// Queries are sorted if they are not already, then answered together:
+    /// at each node the sorted queries are split around its key and only the
+    /// subtrees containing queries are visited. Shared path prefixes are
+    /// walked once, for O(m log(n/m)) node visits over m queries.
+    template<typename RandomIt, typename OutputIt>
+    OutputIt find_sorted(RandomIt first, RandomIt last, OutputIt out) {
+      if(is_small() || Indexed) {
+        for(; first != last; ++first, ++out) *out = find(*first);
+        return out;
+      }
+      std::vector<node*> res(last - first);
+      sorted_finder(first, last, res.data());
+      for(size_t i = 0; i < res.size(); ++i, ++out)
+        *out = is_live(res[i]) ? iterator(res[i]) : end();
+      return out;
+    }
+
+    /// @brief Search the container for every key in a batch by a single
+    ///        merged traversal of the tree
+    /// @tparam RandomIt Random access iterator over keys
+    /// @tparam OutputIt Output iterator accepting const_iterator
+    /// @param first Beginning of keys
+    /// @param last End of keys
+    /// @param out Destination, receives one iterator per key in input order,
+    ///        cend() if the key is not found
+    /// @return Output iterator past the last written result
+    template<typename RandomIt, typename OutputIt>
+    OutputIt find_sorted(RandomIt first, RandomIt last, OutputIt out) const {
+      if(is_small() || Indexed) {
+        for(; first != last; ++first, ++out) *out = find(*first);
+        return out;
+      }
+      std::vector<node*> res(last - first);
+      sorted_finder(first, last, res.data());
+      for(size_t i = 0; i < res.size(); ++i, ++out)
+        *out = is_live(res[i]) ? const_iterator(res[i]) : cend();
+      return out;
     }
 
     /// @brief Count elements with specific keys
@@ -251,16 +1229,68 @@ class map {
     /// only return 1 or 0.
     size_t count(const Key& k) const {
       /// @todo Implement count. Utilize the find operation.
-      node* n = finder(k);
-      int count = 0;
-      if(n->value.first == k) ++count;
-      return count;
+      return lookup(k) ? 1 : 0;
     }
 
 
     bool balanced()
     {
-	return root->left->balanced();
+	return is_small() || Balance::balanced(root->left);
+    }
+
+    /// @return Does the whole structure hold together?
+    ///
+    /// Walks every node in O(n), which is meant for tests: keys must be in
+    /// strictly increasing order, every child must link back to its parent,
+    /// and the entries and tombstones found must match size(). Every internal
+    /// node must also pass the policy's \c verify hook, given the values the
+    /// hook returned for its subtrees (0 for external leaves): AVL balance
+    /// factors, WAVL ranks and treap heap order are all checked this way.
+    bool valid() const {
+      if(is_small()) {
+        for(size_t i = 1; i < sz; ++i)
+          if(!(store.slot(i - 1)->key() < store.slot(i)->key()))
+            return false;
+        return sz <= SmallSize;
+      }
+      struct frame {
+        const node* n; ///< Node
+        int step;      ///< Subtrees done, 0, 1 or 2
+        long l;        ///< Value of verify for the left subtree once done
+      };
+      std::vector<frame> st(1, frame{root->left, 0, 0});
+      const node* prev = nullptr;
+      size_t live = 0, dead = 0;
+      long h = 0;
+      if(root->left->get_parent() != root) return false;
+      while(!st.empty()) {
+        frame& f = st.back();
+        const node* n = f.n;
+        if(n->is_external()) {
+          h = 0;
+          st.pop_back();
+        }
+        else if(f.step == 0) {
+          if(n->left->get_parent() != n || n->right->get_parent() != n)
+            return false;
+          f.step = 1;
+          st.push_back(frame{n->left, 0, 0});
+        }
+        else if(f.step == 1) {
+          if(prev && !(prev->key() < n->key())) return false;
+          prev = n;
+          ++(n->is_dead() ? dead : live);
+          f.l = h;
+          f.step = 2;
+          st.push_back(frame{n->right, 0, 0});
+        }
+        else {
+          h = Balance::verify(n, f.l, h);
+          if(h < 0) return false;
+          st.pop_back();
+        }
+      }
+      return live == sz && dead == tombs;
     }
 
     /// @}
@@ -278,23 +1308,198 @@ class map {
     ///         inserted
     ///
     /// Base your algorithm off of Code Fragment 10.9 on page 436
+    ///
+    /// The descent starts from climb() rather than the root, so a run of
+    /// lookups in key order costs O(1) amortized each, as iteration does.
+    /// Nearby keys are usually cheap too, but two neighbours on either side
+    /// of a high ancestor still climb to it, so a single lookup costs
+    /// O(log n) in the worst case, at most about twice the height.
+    ///
+    /// For string keys, the prefix that \c k shares with both the closest
+    /// smaller and larger key passed on the way down is shared with every key
+    /// below, so compare_keys() skips it and each byte of \c k is matched
+    /// about once per level instead of from the start.
     node* finder(const Key& k) const {		
-      node* v=root->left;
+      node* v=climb(k);
       if(v->is_external()) return v;				// if the root is external, it is the only node in the tree
-      while(v->is_internal() && k != v->value.first)		// search for k
+      size_t lo = 0, hi = 0;					// common prefix of k with the bounding keys on either side
+      while(v->is_internal())					// search for k
       {
-	if (v->is_external()) return v;				// if v is external, then the key does not exist
-	else if(k < v->value.first)				// if k is less than the current key
+	size_t l = lo < hi ? lo : hi;				// every key between the bounds shares this much with k
+	int c = compare_keys(k, v->key(), l);
+	if(c < 0)						// if k is less than the current key
 	{
+		hi = l;
 		v=v->left;					// check the left subtree of v
 	}
-        else if (v->value.first < k)				// if k is greater than the current key
+        else if(c > 0)						// if k is greater than the current key
 	{
+		lo = l;
 		v=v->right;					// check the right subtree of v
 	}
-	else if (v->value.first == k) return v;			// if k is equal to the current key, then we have found k
+	else return v;						// if k is equal to the current key, then we have found k
       }
-      return v;
+      return v;						// v is external, then the key does not exist
+    }
+
+    /// @brief Utility for finger search, climbing from the last accessed node
+    /// @param k Key
+    /// @return Lowest node on the path from the finger up whose subtree must
+    ///         hold \c k, the finger itself when \c k is within its bounds,
+    ///         or the top of the tree when there is no finger
+    ///
+    /// While \c k is below the finger, every ancestor entered from its left
+    /// child is above \c k too, so only those entered from their right child
+    /// are compared: each is the lower bound of the nodes climbed since the
+    /// previous one, which hold \c k if the bound is below it (and
+    /// symmetrically above the finger). One comparison per such ancestor, and
+    /// a random key climbs at most the height of the tree.
+    node* climb(const Key& k) const {
+      node* v = finger;
+      if(!v) return root->left;
+      node* c = v;
+      if(k < v->key()) {
+        for(node* p = v->get_parent(); !p->is_root(); v = p, p = p->get_parent())
+          if(v == p->right) {
+            if(p->key() < k) return c;
+            c = p;
+          }
+      }
+      else if(v->key() < k) {
+        for(node* p = v->get_parent(); !p->is_root(); v = p, p = p->get_parent())
+          if(v == p->left) {
+            if(k < p->key()) return c;
+            c = p;
+          }
+      }
+      return c;
+    }
+
+    /// @brief Record a lookup hit, moving the finger to the node and letting
+    ///        the balancing policy react
+    /// @param n Node found
+    /// @return \c n
+    node* touch(node* n) {
+      finger = n;
+      if(!bulk) Balance::accessed(n);
+      return n;
+    }
+
+    /// @brief Move the finger after a node was unlinked
+    /// @param s Node promoted into the place of the removed one
+    void refinger(node* s) {
+      if(s->is_internal()) finger = s;
+      else finger = s->get_parent()->is_root() ? nullptr : s->get_parent();
+    }
+
+    /// @param n Node
+    /// @return Does \c n hold an entry, being internal and not a tombstone?
+    static bool is_live(const node* n) {
+      return n->is_internal() && !n->is_dead();
+    }
+
+    /// @brief Utility for point lookups
+    /// @param k Key
+    /// @return Node with key \c k, nullptr if there is none
+    node* lookup(const Key& k) const {
+      if(is_small()) {
+        size_t i;
+        return small_finder(k, i);
+      }
+      if(Indexed) return index.find(k);
+      node* v = finder(k);
+      return is_live(v) ? v : nullptr;
+    }
+
+    /// @brief Utility for finding a group of keys with interleaved descents
+    /// @tparam ForwardIt Forward iterator over keys
+    /// @param keys Iterators to the keys of the group
+    /// @param nodes Output, node where each key exists or would be inserted
+    /// @param g Size of the group, at most batch_size
+    template<typename ForwardIt>
+    void batch_finder(const ForwardIt* keys, node** nodes, size_t g) const {
+      for(size_t i = 0; i < g; ++i)
+        nodes[i] = root->left;
+      bool active = true;
+      while(active) {
+        active = false;
+        for(size_t i = 0; i < g; ++i) {
+          node* v = nodes[i];
+          if(v->is_external()) continue;
+          if(*keys[i] < v->key()) v = v->left;
+          else if(v->key() < *keys[i]) v = v->right;
+          else continue;
+          prefetch(v);
+          nodes[i] = v;
+          active = true;
+        }
+      }
+    }
+
+    /// @brief Utility for finding a batch of keys with one co-traversal
+    /// @tparam RandomIt Random access iterator over keys
+    /// @param first Beginning of keys
+    /// @param last End of keys
+    /// @param res Output, node where each key exists or would be inserted
+    template<typename RandomIt>
+    void sorted_finder(RandomIt first, RandomIt last, node** res) const {
+      std::vector<size_t> order(last - first);
+      for(size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+      if(!std::is_sorted(first, last))
+        std::sort(order.begin(), order.end(),
+            [&](size_t a, size_t b) {return first[a] < first[b];});
+      co_finder(root->left, first, order.data(), order.data() + order.size(),
+          res);
+    }
+
+    /// @brief Co-traversal of sorted_finder
+    /// @tparam RandomIt Random access iterator over keys
+    /// @param v Subtree root
+    /// @param keys Beginning of keys
+    /// @param lo Beginning of sorted query indices falling into \c v
+    /// @param hi End of sorted query indices falling into \c v
+    /// @param res Output, node where each key exists or would be inserted
+    ///
+    /// Subtrees left to visit are kept on an explicit stack holding only those
+    /// with queries, so a tree of any height (e.g., a splay tree that became a
+    /// path) uses memory bounded by the number of keys, not the call stack.
+    template<typename RandomIt>
+    void co_finder(node* v, RandomIt keys, const size_t* lo, const size_t* hi,
+        node** res) const {
+      struct range {
+        node* v;          ///< Subtree root
+        const size_t* lo; ///< Beginning of its query indices
+        const size_t* hi; ///< End of its query indices
+      };
+      std::vector<range> st;
+      if(lo != hi) st.push_back(range{v, lo, hi});
+      while(!st.empty()) {
+        range r = st.back();
+        st.pop_back();
+        if(r.v->is_external()) {
+          for(const size_t* p = r.lo; p != r.hi; ++p) res[*p] = r.v;
+          continue;
+        }
+        const Key& k = r.v->key();
+        const size_t* mid = std::lower_bound(r.lo, r.hi, k,
+            [&](size_t i, const Key& x) {return keys[i] < x;});
+        const size_t* up = std::upper_bound(mid, r.hi, k,
+            [&](const Key& x, size_t i) {return x < keys[i];});
+        for(const size_t* p = mid; p != up; ++p) res[*p] = r.v;
+        if(up != r.hi) st.push_back(range{r.v->right, up, r.hi});
+        if(r.lo != mid) st.push_back(range{r.v->left, r.lo, mid});
+      }
+    }
+
+    /// @brief Hint the processor to start loading a node into cache
+    /// @param n Node
+    static void prefetch(const node* n) {
+#if defined(__GNUC__)
+      __builtin_prefetch(n);
+#else
+      (void)n;
+#endif
     }
 
     /// @brief Utility for inserting a new node into the data structure.
@@ -310,14 +1515,297 @@ class map {
     ///
     /// Hint: Will need to use functions node::replace and node::expand
     std::pair<node*, bool> inserter(const value_type& v) {		
+      if(is_small()) {
+        size_t j;
+        node* e = small_finder(v.first, j);
+        if(e) return std::make_pair(e, false);
+        if(sz < SmallSize) return std::make_pair(small_inserter(j, v), true);
+        promote();
+      }
+      if(node* e = index.find(v.first)) return std::make_pair(e, false);
       node* i = finder(v.first);					// find the node or the place the node should be inserted
-      if (i->is_internal()) return std::make_pair(i,false); 		// if i is an internal node, then it already exists
-      i->expand();							// otherwise i is an external nodes, and needs to become an internal node
+      if (i->is_internal()) {
+        if(!i->is_dead()) return std::make_pair(touch(i),false); 		// if i is an internal node, then it already exists
+        // a tombstone takes the entry back, rebalance_insert clears its mark
+        i->replace(v);
+        index.set(i->key(), i);
+        finger = i;
+        sz++;
+        tombs--;
+        return std::make_pair(i, true);
+      }
+      expand(i);							// otherwise i is an external nodes, and needs to become an internal node
       i->replace(v);
+      if(!i->get_parent()->is_root())
+        share_prefix(i->key(), i->get_parent()->key());
+      index.set(i->key(), i);
+      finger = i;
       sz++;			// increase size by 1
       return std::make_pair(i, true);
     }
 
+    /// @brief Utility for linking a detached node into the data structure
+    /// @param h Node with its carried leaf as left child
+    /// @return pair of node and bool. node pointing to inserted or already
+    ///         existing element. bool is true if \c h was linked, in which
+    ///         case the tree owns it.
+    ///
+    /// The external leaf where the key belongs becomes the right child of
+    /// \c h, and the carried leaf its left child.
+    std::pair<node*, bool> node_inserter(node* h) {
+      h->sync_key();
+      if(is_small()) {
+        size_t j;
+        node* e = small_finder(h->key(), j);
+        if(e) return std::make_pair(e, false);
+        if(sz < SmallSize) {
+          e = small_inserter(j, h->entry());
+          node::destroy(h->left);
+          node::destroy(h);
+          return std::make_pair(e, true);
+        }
+        promote();
+      }
+      node* i = finder(h->key());
+      if(i->is_internal() && !i->is_dead())
+        return std::make_pair(finger = i, false);
+      if(i->is_internal()) {
+        // revive the tombstone with the entry rather than link a second node
+        i->take(*h);
+        i->set_dead(false);
+        recycle(h->left);
+        recycle(h);
+        index.set(i->key(), i);
+        finger = i;
+        sz++;
+        tombs--;
+        return std::make_pair(i, true);
+      }
+      node* p = i->get_parent();
+      if(p->left == i) p->left = h;
+      else p->right = h;
+      h->set_parent(p);
+      h->set_children(h->left, i);
+      h->set_balance(0);
+      index.set(h->key(), h);
+      finger = h;
+      sz++;
+      rebalance_insert(h);
+      return std::make_pair(h, true);
+    }
+
+    /// @brief Detach a node from the tree without moving its value
+    /// @param n Node to detach
+    /// @return \c n, holding one external leaf as its left child
+    ///
+    /// Like eraser, but when \c n has two internal children the successor
+    /// node itself takes the place of \c n rather than its value.
+    node* extractor(node* n) {
+      index.erase(n->key());
+      if(finger == n) finger = nullptr;
+      node* leaf;
+      node* start;
+      node* p = n->get_parent();
+      if(n->left->is_external() || n->right->is_external()) {
+        leaf = n->left->is_external() ? n->left : n->right;
+        start = leaf == n->left ? n->right : n->left;
+        if(p->left == n) p->left = start;
+        else p->right = start;
+        start->set_parent(p);
+      }
+      else {
+        node* u = n->right->leftmost();
+        node* up = u->get_parent();
+        leaf = u->left;
+        start = u->right;
+        if(up->left == u) up->left = start;
+        else up->right = start;
+        start->set_parent(up);
+        if(p->left == n) p->left = u;
+        else p->right = u;
+        u->set_parent(p);
+        u->set_children(n->left, n->right);
+        Balance::copied(u, *n);
+      }
+      n->left = leaf;
+      leaf->set_parent(n);
+      n->right = nullptr;
+      n->set_parent(nullptr);
+      n->set_balance(0);
+      sz--;
+      rebalance(start);
+      return n;
+    }
+
+    /// @brief Restore balance after a structural change below a node
+    /// @param n Node whose parent is the lowest node that may have changed
+    ///
+    /// Skipped in bulk mode.
+    void rebalance(node* n) {
+      if(!bulk) Balance::erased(n);
+    }
+
+    /// @brief Restore balance after inserting a node
+    /// @param n Newly inserted node
+    ///
+    /// In bulk mode only a subtree that has become too deep is rebuilt. A
+    /// revived tombstone changed no shape, and only loses its mark.
+    void rebalance_insert(node* n) {
+      if(n->is_dead()) {
+        n->set_dead(false);
+        return;
+      }
+      if(!bulk) {
+        Balance::inserted(n);
+        return;
+      }
+      size_t d = 0;
+      for(node* p = n; !p->get_parent()->is_root(); p = p->get_parent()) ++d;
+      if(d <= std::log(double(sz)) / std::log(1.5)) return;
+
+      // find the lowest ancestor whose heavier child holds more than 2/3 of
+      // its entries
+      node* c = n;
+      size_t cs = 1;
+      while(!c->get_parent()->is_root()) {
+        node* p = c->get_parent();
+        size_t ps = cs + 1 + subtree_size(p->left == c ? p->right : p->left);
+        if(3 * cs > 2 * ps) break;
+        c = p;
+        cs = ps;
+      }
+      rebuild(c->get_parent()->is_root() ? c : c->get_parent());
+    }
+
+    /// @param b Requested bytes
+    /// @return Estimated bytes taken by a malloc of \c b bytes, see
+    ///         memory_stats
+    static size_t malloc_chunk(size_t b) {
+      b += sizeof(size_t);
+      return b < 32 ? 32 : (b + 15) & ~size_t(15);
+    }
+
+    /// @param slabs Output, distinct slabs holding nodes or spare slots of
+    ///        the tree, sorted
+    /// @return Number of nodes of the tree made by new, sentinel included
+    size_t slab_census(std::vector<std::uintptr_t>& slabs) const {
+      size_t heap = 0;
+      for(node* n : spare)
+        slabs.push_back(slab_allocator::slab_of(n));
+      std::vector<const node*> st(1, root);
+      while(!st.empty()) {
+        const node* v = st.back();
+        st.pop_back();
+        if(!v->in_slab()) ++heap;
+        else if(slabs.empty() ||
+            slabs.back() != slab_allocator::slab_of(v))
+          slabs.push_back(slab_allocator::slab_of(v));
+        if(v->left) st.push_back(v->left);
+        if(v->right) st.push_back(v->right);
+      }
+      std::sort(slabs.begin(), slabs.end());
+      slabs.erase(std::unique(slabs.begin(), slabs.end()), slabs.end());
+      return heap;
+    }
+
+    /// @param n Subtree root
+    /// @return Number of entries in the subtree
+    static size_t subtree_size(node* n) {
+      size_t s = 0;
+      std::vector<node*> st(1, n);
+      while(!st.empty()) {
+        node* v = st.back();
+        st.pop_back();
+        if(v->is_external()) continue;
+        ++s;
+        st.push_back(v->left);
+        st.push_back(v->right);
+      }
+      return s;
+    }
+
+    /// @brief Relink a subtree into a perfectly balanced shape in O(n)
+    /// @param t Subtree root, an internal node
+    ///
+    /// The nodes are reused, none are allocated or copied. Balance factors
+    /// inside the subtree are recomputed. Tombstones are freed along with as
+    /// many external nodes.
+    void rebuild(node* t) {
+      node* p = t->get_parent();
+      bool left = p->left == t;
+      std::vector<node*> in, ex, dead;
+      std::vector<node*> st;
+      for(node* c = t; c || !st.empty();) {
+        if(c && c->is_external()) {
+          ex.push_back(c);
+          c = nullptr;
+        }
+        else if(c) {
+          st.push_back(c);
+          c = c->left;
+        }
+        else {
+          c = st.back();
+          st.pop_back();
+          (c->is_dead() ? dead : in).push_back(c);
+          c = c->right;
+        }
+      }
+      if(!dead.empty()) {
+        for(node* d : dead)
+          recycle(d);
+        for(size_t i = in.size() + 1; i < ex.size(); ++i)
+          recycle(ex[i]);
+        ex.resize(in.size() + 1);
+        tombs -= dead.size();
+        finger = nullptr;
+      }
+      size_t h;
+      node* r = build(in.data(), ex.data(), 0, in.size(), h);
+      if(left) p->left = r;
+      else p->right = r;
+      r->set_parent(p);
+    }
+
+    /// @brief Build a balanced subtree from nodes in inorder
+    /// @param in Internal nodes in inorder
+    /// @param ex External nodes in inorder, one more than \c in
+    /// @param lo First internal node
+    /// @param hi One past the last internal node
+    /// @param h Set to the height of the subtree
+    /// @return Root of the subtree
+    static node* build(node* const* in, node* const* ex, size_t lo, size_t hi,
+        size_t& h) {
+      if(lo == hi) {
+        h = 0;
+        return ex[lo];
+      }
+      size_t mid = lo + (hi - lo) / 2;
+      node* n = in[mid];
+      size_t hl, hr;
+      node* l = build(in, ex, lo, mid, hl);
+      node* r = build(in, ex, mid + 1, hi, hr);
+      n->set_children(l, r);
+      Balance::built(n, hl, hr);
+      h = 1 + (hl > hr ? hl : hr);
+      return n;
+    }
+
+    /// @brief Erase a node lazily, leaving it in the tree as a tombstone
+    /// @param n Node to erase
+    ///
+    /// Once tombstones pass the policy's share of the nodes, the whole tree is
+    /// rebuilt without them. Live nodes are relinked, not moved, so iterators
+    /// to them stay valid.
+    void bury(node* n) {
+      index.erase(n->key());
+      n->set_dead(true);
+      sz--;
+      tombs++;
+      if(tombs * 100 > Balance::tombstone_percent * (sz + tombs))
+        rebuild(root->left);
+    }
+
     /// @brief Erase a node from the tree
     /// @param n Node to erase
     /// @return Next inorder successor of \c n in tree
@@ -329,22 +1817,379 @@ class map {
     node* eraser(node* n) {
       /// @todo Implement eraser helper function
       node* w;
+      index.erase(n->key());
       if(n->left->is_external()){
         w = n->left;}
       else if(n->right->is_external()){
         w = n->right;
      }else
       {
-        w = n->right;
-       /* do{
-          w = w->left;
-          }while(w->is_internal());*/
-        w = w->leftmost();
-        node* u = w->parent;
-	      n->replace(u->value);
+        w = n->right->leftmost();		// inorder successor, its left child is external
+	      n->take(*w);
+        index.set(n->key(), n);
+        w = w->left;
       }
       sz--;
-      return w->remove_above_external();
+      node* par = w->get_parent();
+      node* s = w->remove_above_external();
+      recycle(w);
+      recycle(par);
+      refinger(s);
+      return s;
+    }
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Copy and Teardown Helpers
+    /// @{
+
+    /// @param n Number of entries
+    /// @return Depth at which subtrees of a tree with \c n entries are handed
+    ///         to separate threads, 0 to stay on the calling thread
+    static size_t fanout_depth(size_t n) {
+      if(n < parallel_threshold) return 0;
+      size_t t = std::thread::hardware_concurrency();
+      size_t d = 0;
+      while((size_t(1) << d) < t && d < 4) ++d;
+      return d;
+    }
+
+    /// @brief Split a tree at a fixed depth
+    /// @param n Subtree root
+    /// @param d Depth to split at
+    /// @param subs Output, subtrees at depth \c d in inorder
+    /// @param tops Output if given, internal nodes above depth \c d
+    static void split(node* n, size_t d, std::vector<node*>& subs,
+        std::vector<node*>* tops) {
+      if(d == 0 || n->is_external()) {
+        subs.push_back(n);
+        return;
+      }
+      if(tops) tops->push_back(n);
+      split(n->left, d - 1, subs, tops);
+      split(n->right, d - 1, subs, tops);
+    }
+
+    /// @brief Copy a single node into a slab, without its links
+    /// @param s Source node
+    /// @param a Slab allocator
+    /// @param move Move the entry out of \c s instead of copying it
+    /// @return Copy
+    static node* clone_node(const node& s, slab_allocator& a, bool move) {
+      node* c = move ?
+        new (a.allocate()) node(std::move(const_cast<node&>(s))) :
+        s.has_entry() ? new (a.allocate()) node(s.entry()) :
+        new (a.allocate()) node();
+      Balance::copied(c, s);
+      c->set_dead(s.is_dead());
+      c->set_in_slab();
+      return c;
+    }
+
+    /// @brief Deep copy a subtree without recursion
+    /// @param s Source subtree
+    /// @param a Slab allocator
+    /// @param move Move the entries instead of copying them
+    /// @return Copy, whose nodes are allocated in inorder sequence
+    static node* clone_tree(const node* s, slab_allocator& a, bool move) {
+      struct frame {
+        const node* s; ///< Source node
+        node* c;       ///< Copy, once the left subtree is done
+        node* l;       ///< Copy of the left subtree
+      };
+      std::vector<frame> st;
+      st.push_back(frame{s, nullptr, nullptr});
+      node* done = nullptr;
+      while(!st.empty()) {
+        frame& f = st.back();
+        if(f.s->is_external())
+          done = clone_node(*f.s, a, move);
+        else if(!f.l) {
+          const node* l = f.s->left;
+          st.push_back(frame{l, nullptr, nullptr});
+          continue;
+        }
+        else if(!f.c) {
+          f.c = clone_node(*f.s, a, move);
+          const node* r = f.s->right;
+          st.push_back(frame{r, nullptr, nullptr});
+          continue;
+        }
+        else
+          done = f.c->set_children(f.l, done);
+        // hand the finished copy to the parent, as its left child if the
+        // parent has not started its right subtree
+        st.pop_back();
+        if(!st.empty() && !st.back().l)
+          st.back().l = done;
+      }
+      return done;
+    }
+
+    /// @brief Copy the part of a tree above the split depth
+    /// @param s Source subtree
+    /// @param d Remaining depth to the split
+    /// @param a Slab allocator
+    /// @param subs Copies of the subtrees at the split, consumed in inorder
+    /// @param move Move the entries instead of copying them
+    /// @return Copy
+    static node* clone_top(const node* s, size_t d, slab_allocator& a,
+        node* const*& subs, bool move) {
+      if(d == 0 || s->is_external()) return *subs++;
+      node* l = clone_top(s->left, d - 1, a, subs, move);
+      node* c = clone_node(*s, a, move);
+      node* r = clone_top(s->right, d - 1, a, subs, move);
+      return c->set_children(l, r);
+    }
+
+    /// @brief Deep copy the tree of another map
+    /// @param m Other map, not in small-size mode
+    /// @param move Move the entries out of \c m instead of copying them, the
+    ///        caller then frees the tree of \c m
+    /// @return Copy of the root sentinel with all of its descendants
+    ///
+    /// For large trees the subtrees below fanout_depth() are copied by
+    /// separate threads, each filling its own slabs.
+    static node* clone(const map& m, bool move = false) {
+      slab_allocator a;
+      node* r = clone_node(*m.root, a, move);
+      size_t d = fanout_depth(m.sz);
+      node* t;
+      if(d == 0)
+        t = clone_tree(m.root->left, a, move);
+      else {
+        std::vector<node*> subs, copies;
+        split(m.root->left, d, subs, nullptr);
+        copies.resize(subs.size());
+        std::vector<std::thread> workers;
+        for(size_t i = 0; i < subs.size(); ++i)
+          workers.push_back(std::thread([&subs, &copies, i, move]() {
+                slab_allocator w;
+                copies[i] = clone_tree(subs[i], w, move);
+                }));
+        for(size_t i = 0; i < workers.size(); ++i)
+          workers[i].join();
+        node* const* next = copies.data();
+        t = clone_top(m.root->left, d, a, next, move);
+      }
+      return r->set_children(t, clone_node(*m.root->right, a, move));
+    }
+
+    /// @brief Turn an external node into an internal one with two new leaves
+    /// @param n External node
+    void expand(node* n) {
+      n->left = make_node();
+      n->right = make_node();
+      n->left->set_parent(n);
+      n->right->set_parent(n);
+    }
+
+    /// @return A new external node, in a spare slab slot if there is one
+    node* make_node() {
+      if(spare.empty()) return new node;
+      node* n = new (spare.back()) node;
+      spare.pop_back();
+      n->set_in_slab();
+      return n;
+    }
+
+    /// @brief Free a node unlinked from the tree
+    /// @param n Node, children are not touched
+    ///
+    /// A slab node's slot is kept as a spare for make_node(), since slab slots
+    /// are otherwise never reused. Once spares outnumber the nodes of the tree
+    /// they all go back to their slabs, which frees every slab left empty.
+    void recycle(node* n) {
+      if(!n->in_slab()) {
+        delete n;
+        return;
+      }
+      n->~node();
+      spare.push_back(n);
+      if(spare.size() > 2 * (sz + tombs) + spare_slack)
+        release_spare();
+    }
+
+    /// @brief Hand all spare slots back to their slabs
+    void release_spare() noexcept {
+      for(node* n : spare)
+        slab_allocator::release(n);
+      spare.clear();
+    }
+
+    /// @brief Free a subtree without recursion
+    /// @param n Subtree root
+    static void destroy_tree(node* n) {
+      std::vector<node*> st(1, n);
+      while(!st.empty()) {
+        node* v = st.back();
+        st.pop_back();
+        if(v->is_internal()) {
+          st.push_back(v->left);
+          st.push_back(v->right);
+        }
+        node::destroy(v);
+      }
+    }
+
+    /// @brief Free the whole tree including the root sentinel
+    ///
+    /// For large trees the subtrees below fanout_depth() are freed by
+    /// separate threads.
+    void teardown() {
+      size_t d = fanout_depth(sz);
+      if(d == 0) {
+        destroy_tree(root);
+        return;
+      }
+      std::vector<node*> subs, tops;
+      split(root->left, d, subs, &tops);
+      std::vector<std::thread> workers;
+      for(size_t i = 0; i < subs.size(); ++i)
+        workers.push_back(std::thread(&map::destroy_tree, subs[i]));
+      for(size_t i = 0; i < tops.size(); ++i)
+        node::destroy(tops[i]);
+      node::destroy(root->right);
+      node::destroy(root);
+      for(size_t i = 0; i < workers.size(); ++i)
+        workers[i].join();
+    }
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Small-Size Mode Helpers
+    /// @{
+
+    /// @return Are the entries held inline rather than in the tree?
+    bool is_small() const {return SmallSize > 0 && root == store.head();}
+
+    /// @return First node in order, root if empty
+    node* first() const {
+      if(is_small()) return sz ? root->left : root;
+      node* n = root->leftmost();
+      while(n->is_dead()) n = n->inorder_next();
+      return n;
+    }
+
+    /// @brief Set up an empty map, inline when small-size mode is enabled
+    void init() {
+      sz = 0;
+      tombs = 0;
+      if(SmallSize > 0) {
+        root = new (store.head()) node();
+      }
+      else {
+        root = new node();
+        root->expand();
+      }
+    }
+
+    /// @brief Copy the entries of another map into this empty one
+    /// @param m Other map
+    void copy_from(const map& m) {
+      if(m.is_small()) {
+        init();
+        for(size_t i = 0; i < m.sz; ++i)
+          small_inserter(i, m.store.slot(i)->entry());
+      }
+      else {
+        root = clone(m);
+        sz = m.sz;
+        tombs = m.tombs;
+        if(m.bulk && root->left->is_internal())
+          rebuild(root->left);
+        reindex();
+      }
+    }
+
+    /// @brief Free all entries, leaves the map without a root
+    void release() noexcept {
+      if(is_small()) {
+        for(size_t i = 0; i < sz; ++i)
+          store.slot(i)->~node();
+        root->left = root->right = nullptr;
+        root->~node();
+      }
+      else
+        teardown();
+      release_spare();
+      root = nullptr;
+      finger = nullptr;
+      index.clear();
+    }
+
+    /// @brief Refill the side index from the tree after nodes were relocated
+    void reindex() {
+      if(!Indexed) return;
+      index.clear();
+      index.reserve(sz);
+      for(node* n = first(); n != root; n = n->inorder_next())
+        if(!n->is_dead()) index.set(n->key(), n);
+    }
+
+    /// @brief Linear search of the inline entries
+    /// @param k Key
+    /// @param i Output, index of the first entry not less than \c k
+    /// @return Entry with key \c k, nullptr if there is none
+    node* small_finder(const Key& k, size_t& i) const {
+      for(i = 0; i < sz; ++i) {
+        node* e = store.slot(i);
+        if(!(e->key() < k))
+          return k < e->key() ? nullptr : e;
+      }
+      return nullptr;
+    }
+
+    /// @brief Insert an inline entry, shifting later entries up
+    /// @param i Index to insert at
+    /// @param v Key, Value pair
+    /// @return New entry
+    node* small_inserter(size_t i, const value_type& v) {
+      for(size_t j = sz; j > i; --j) {
+        new (store.slot(j)) node(std::move(*store.slot(j - 1)));
+        store.slot(j)->set_parent(root);
+        store.slot(j - 1)->~node();
+      }
+      node* e = new (store.slot(i)) node(v);
+      e->set_parent(root);
+      ++sz;
+      root->left = store.slot(0);
+      root->right = store.slot(sz - 1);
+      return e;
+    }
+
+    /// @brief Erase an inline entry, shifting later entries down
+    /// @param i Index to erase
+    void small_eraser(size_t i) {
+      store.slot(i)->~node();
+      for(size_t j = i + 1; j < sz; ++j) {
+        new (store.slot(j - 1)) node(std::move(*store.slot(j)));
+        store.slot(j - 1)->set_parent(root);
+        store.slot(j)->~node();
+      }
+      --sz;
+      root->left = sz ? store.slot(0) : nullptr;
+      root->right = sz ? store.slot(sz - 1) : nullptr;
+    }
+
+    /// @brief Move the inline entries into a newly built AVL tree
+    void promote() {
+      node* t = new node();
+      t->expand();
+      node* h = root;
+      size_t n = sz;
+      root = t;
+      sz = 0;
+      for(size_t i = 0; i < n; ++i) {
+        rebalance_insert(inserter(store.slot(i)->entry()).first);
+        store.slot(i)->~node();
+      }
+      h->left = h->right = nullptr;
+      h->~node();
     }
 
     /// @}
@@ -358,6 +2203,19 @@ class map {
                     ///< for end iterator. root.left is the "true" root for the
                     ///< data
     size_t sz;      ///< Number of nodes
+    size_t tombs;   ///< Number of tombstones, not counted in sz
+    size_t bulk;    ///< Nesting depth of bulk mode, 0 when off
+    node* finger;   ///< Last accessed internal node, where finder starts,
+                    ///< nullptr if none
+    std::vector<node*> spare; ///< Freed slab slots, reused for new nodes
+
+    static constexpr size_t batch_size = 16; ///< Lookups interleaved by
+                                             ///< find_many
+    static constexpr size_t spare_slack = 256; ///< Spare slots kept beyond
+                                               ///< the size of the tree
+    static constexpr size_t parallel_threshold = 1 << 16; ///< Entries before
+                                                          ///< copy and teardown
+                                                          ///< use threads
 
     /// @}
     ////////////////////////////////////////////////////////////////////////////
@@ -366,41 +2224,157 @@ class map {
     /// @name Types
     /// @{
 
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Entry held inside a node
+    /// @tparam Boxed Is the entry held out of line
+    ////////////////////////////////////////////////////////////////////////////
+    template<bool Boxed, typename = void>
+      struct entry_store {
+        /// @brief Constructor, a default entry
+        entry_store() : value() {}
+        /// @brief Constructor
+        /// @param v Map entry (Key, Value) pair
+        entry_store(const value_type& v) : value(v) {}
+        /// @brief Constructor taking over the entry of another store
+        /// @param s Other store, left with a moved-from entry
+        entry_store(entry_store&& s) :
+          value(std::move(const_cast<Key&>(s.value.first)),
+              std::move(s.value.second)) {}
+
+        /// @return Key
+        const Key& key() const {return value.first;}
+        /// @return Entry
+        value_type& entry() const {return const_cast<value_type&>(value);}
+        /// @return Always true, every node holds an entry
+        bool has_entry() const {return true;}
+
+        /// @brief Replace value of node, used for setting values on external
+        ///        placeholder nodes
+        /// @param v New value
+        void replace(const value_type& v) {
+          const_cast<Key&>(value.first) = v.first;
+          value.second = v.second;
+        }
+        /// @brief Take over the entry of another node about to be destroyed
+        /// @param s Other store
+        void take(entry_store& s) {
+          const_cast<Key&>(value.first) =
+            std::move(const_cast<Key&>(s.value.first));
+          value.second = std::move(s.value.second);
+        }
+        /// @brief Nothing to do, the key is not copied
+        void sync_key() {}
+
+        value_type value; ///< Value is pair(key, value)
+      };
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Entry held out of line, only a copy of the key stays in the node
+    ///
+    /// External leaves hold no entry at all. The entry is allocated once and
+    /// handed from node to node by pointer, so it is never copied or moved
+    /// by restructuring, erase or copies made for moving.
+    ////////////////////////////////////////////////////////////////////////////
+    template<typename D>
+      struct entry_store<true, D> {
+        /// @brief Constructor, no entry
+        entry_store() : k(), box(nullptr) {}
+        /// @brief Constructor
+        /// @param v Map entry (Key, Value) pair
+        entry_store(const value_type& v) : k(v.first), box(new value_type(v)) {}
+        /// @brief Constructor taking over the entry of another store
+        /// @param s Other store, left without an entry
+        entry_store(entry_store&& s) : k(s.k), box(s.box) {s.box = nullptr;}
+        /// @brief Destructor, frees the entry
+        ~entry_store() {delete box;}
+
+        /// @brief Copy construction - Deleted
+        entry_store(const entry_store&) = delete;
+        /// @brief Copy assignment - Deleted
+        entry_store& operator=(const entry_store&) = delete;
+
+        /// @return Key
+        const Key& key() const {return k;}
+        /// @return Entry
+        value_type& entry() const {return *box;}
+        /// @return Does the node hold an entry, false for external leaves
+        bool has_entry() const {return box != nullptr;}
+
+        /// @brief Replace value of node, used for setting values on external
+        ///        placeholder nodes
+        /// @param v New value
+        void replace(const value_type& v) {
+          k = v.first;
+          if(box) {
+            const_cast<Key&>(box->first) = v.first;
+            box->second = v.second;
+          }
+          else
+            box = new value_type(v);
+        }
+        /// @brief Take over the entry of another node about to be destroyed
+        /// @param s Other store, left without an entry
+        void take(entry_store& s) {
+          delete box;
+          k = s.k;
+          box = s.box;
+          s.box = nullptr;
+        }
+        /// @brief Copy the key back from the entry after it was changed
+        void sync_key() {k = box->first;}
+
+        Key k;           ///< Copy of the key, searched without touching the
+                         ///< entry
+        value_type* box; ///< Entry, nullptr in external leaves
+      };
+
     ////////////////////////////////////////////////////////////////////////////
     /// @brief Internal structure for binary search tree
+    ///
+    /// The AVL balance factor and the slab flag are packed into the low bits
+    /// of the parent link, which the 8 byte alignment leaves free. With lazy
+    /// erase nodes are aligned to 16 bytes, and a fourth bit marks tombstones.
     ////////////////////////////////////////////////////////////////////////////
-    struct node {
+    struct alignas(Balance::tombstone_percent ? 16 : 8) node :
+      Balance::node_base, entry_store<OutOfLine> {
 
       //////////////////////////////////////////////////////////////////////////
       /// @name Constructors
       /// @{
 
+      /// @brief Constructor, an external node
+      node() : tag(balance_zero), left(nullptr), right(nullptr) {}
+
       /// @brief Constructor
       /// @param v Map entry (Key, Value) pair
-      node(const value_type& v = value_type()) :
-        value(v), parent(nullptr), left(nullptr), right(nullptr), height(0) {}
-
-      /// @brief Copy constructor
-      /// @param n node to perform deep copy from
-      node(const node& n) : value(n.value), parent(nullptr), left(nullptr), right(nullptr), height(n.height) {
-        /// @todo Finish implementation of this copy constructor.
-        ///       Hint: left and right are not copied correctly at the moment
-	       if(n.is_internal())
-         {
-          node* l = new node(*n.left);
-          node* r = new node(*n.right);
-          set_children(l, r);
-         }
-      }
+      node(const value_type& v) :
+        entry_store<OutOfLine>(v), tag(balance_zero), left(nullptr),
+        right(nullptr) {}
+
+      /// @brief Constructor taking over the entry of another node, links and
+      ///        balancing data are not copied
+      /// @param n Other node
+      node(node&& n) :
+        entry_store<OutOfLine>(std::move(n)), tag(balance_zero),
+        left(nullptr), right(nullptr) {}
+
+      /// @brief Copy constructor - Deleted, trees are copied by map::clone
+      /// @param n Other node
+      node(const node& n) = delete;
 
       /// @brief Copy assignment - Deleted
       /// @param n Other node
       node& operator=(const node& n) = delete;
 
-      /// @brief Destructor
-      ~node() {
-        delete right;
-	delete left;
+      /// @brief Free a single node, children are not touched
+      /// @param n Node allocated with new or from a slab
+      static void destroy(node* n) {
+        if(n->in_slab()) {
+          n->~node();
+          slab_allocator::release(n);
+        }
+        else
+          delete n;
       }
 
       /// @}
@@ -410,38 +2384,47 @@ class map {
       /// @name Modifiers
       /// @{
 
-      /// @brief Replace value of node, used for setting values on external
-      ///        placeholder nodes
-      /// @param v New value
-      void replace(const value_type& v) {
-        const_cast<Key&>(value.first) = v.first;
-        value.second = v.second;
+      /// @brief Set the parent, keeping the balance factor and slab flag
+      /// @param p Parent node
+      void set_parent(node* p) {
+        tag = reinterpret_cast<uintptr_t>(p) | (tag & tag_bits);
+      }
+
+      /// @brief Set the balance factor
+      /// @param b Height of right minus height of left child, -1, 0 or 1
+      void set_balance(int b) {
+        tag = (tag & ~balance_bits) | uintptr_t(b + 1);
       }
 
+      /// @brief Mark the node as allocated from a slab
+      void set_in_slab() {tag |= slab_bit;}
+
+      /// @brief Mark or unmark the node as a tombstone
+      /// @param d Is the entry erased?
+      void set_dead(bool d) {tag = d ? tag | dead_bit : tag & ~dead_bit;}
+
       /// @brief Expand external node to make it internal
       void expand() {
         left = new node;
         right = new node;
-        left->parent = this;
-        right->parent = this;
+        left->set_parent(this);
+        right->set_parent(this);
       }
 
       /// @brief Remove above external node, assumes this is external node
       /// @return Sibling of \c n, who is promoted to n's parent's position
+      ///
+      /// This node and its parent are unlinked but not freed.
       node* remove_above_external() {
-        node* par = parent;
+        node* par = get_parent();
         node* sib = this == par->left ? par->right : par->left;
-        node* gpar = par->parent;
+        node* gpar = par->get_parent();
         if(par == gpar->left)
           gpar->left = sib;
         else
           gpar->right = sib;
-        sib->parent = gpar;
+        sib->set_parent(gpar);
         par->left = par->right = nullptr;
-        delete this;
-        delete par;
-        if(sib->is_external())
-          sib = sib->parent;
         return sib;
       }
 
@@ -453,155 +2436,167 @@ class map {
       /// @{
 
       /// @return Height of the node which is 0 for external node
-      size_t get_height() {
-        return this->is_external() ? 0: this->height;
-      }
-
-      /// @return Difference of heights of left and right children
-      int height_diff() {
-        return this->right->get_height() - this->left->get_height();
+      ///
+      /// Only the balance factor is stored, so the height is found by
+      /// descending along the taller side in O(log n).
+      size_t get_height() const {
+        size_t h = 0;
+        for(const node* n = this; n->is_internal();
+            n = n->get_balance() > 0 ? n->right : n->left)
+          ++h;
+        return h;
       }
 
-      /// @brief Set the height as 1 added to the maximum height of its
-      ///        children
-      void set_height() {
-        size_t hl = this->left->get_height();
-        size_t hr = this->right->get_height();
-        this->height = 1 + (hl > hr? hl : hr);
+      /// @return Difference of heights of right and left children
+      int height_diff() const {
+        return int(right->get_height()) - int(left->get_height());
       }
 
       /// @return True when the height difference of the children nodes
-      ///         does not exceed 1
-      bool balanced() {
+      ///         does not exceed 1 and matches the stored balance factor
+      bool balanced() const {
         int bal = height_diff();
-        return ((-1<=bal)&&(bal<=1));
-      }
-
-      /// @brief Given a node this returns the tallest grandchild
-      /// @return The grandchild with the maximum height
-      node* tall_grand_child()  {
-        node* l = left;
-        node* r = right;
-        // left child's height is greater than right child's height
-        if(l->get_height() >= r->get_height())
-          if(l->left->get_height() >= l->right->get_height())
-            return l->left;
-          else
-            return l->right;
-        // right child's height is greater than left child's height
-        else
-          if(r->right->get_height() >= r->left->get_height())
-            return r->right;
-          else
-            return r->left;
+        return ((-1<=bal)&&(bal<=1)) && bal == get_balance();
+      }
+
+      /// @brief Rebalances the tree after the subtree rooted at this node
+      ///        grew by one level.
+      ///
+      /// Balance factors are updated on the path to the root until a node
+      /// whose height did not change. At most one restructuring is needed.
+      void rebalance_insert() {
+        node* c = this;
+        for(node* z = c->get_parent(); !z->is_root();
+            c = z, z = z->get_parent()) {
+          int bal = z->get_balance() + (c == z->right ? 1 : -1);
+          if(bal == 0 || bal == 1 || bal == -1) {
+            z->set_balance(bal);
+            if(bal == 0) return;
+          }
+          else {
+            z->restructure(bal);
+            return;
+          }
+        }
       }
 
-      /// @brief Rebalances the tree from the node to the root.
-      ///        It sets the height of every node in the path to root.
-      ///        On a disbalanced node, restructring is called to restore
-      ///        the balance in the tree.
-      /// Base your algorithm off of Code Fragment 10.17 on page 449 in book
+      /// @brief Rebalances the tree after the subtree rooted at this node
+      ///        lost one level.
       ///
-      /// Hint: will need the functions balanced(), tall_grand_child(),
-      ///       set_height()
+      /// Balance factors are updated on the path to the root until a node
+      /// whose height did not change, restructuring disbalanced nodes on the
+      /// way.
       void rebalance() {
-        /// @todo Implement resbalancing
-        node* z = this;
-	      while(!(z->parent->is_root()))
-	      {
-	        z = z->parent;
-	        z->set_height();
-	        if(!z->balanced())
-	        {
-	          node* x = z->tall_grand_child();
-	          z = x->restructure();
-	          z->left->set_height();
-	          z->right->set_height();
-	          z->set_height();
-	        }
-	      }
-      }
-
-      /// @brief Restructuring the tri-node structure's balance where
-      ///        the grandparent of the node is disbalanced.
-      /// @return The tri-node structure after restructring
+        node* c = this;
+        for(node* z = c->get_parent(); !z->is_root(); z = c->get_parent()) {
+          int bal = z->get_balance() + (c == z->right ? -1 : 1);
+          if(bal == 1 || bal == -1) {
+            z->set_balance(bal);
+            return;
+          }
+          if(bal == 0) {
+            z->set_balance(bal);
+            c = z;
+            continue;
+          }
+          // a single rotation over an evenly balanced child keeps the height
+          bool even = (bal > 0 ? z->right : z->left)->get_balance() == 0;
+          c = z->restructure(bal);
+          if(even) return;
+        }
+      }
+
+      /// @brief Restructuring the tri-node structure of a disbalanced node
+      /// @param bal Balance factor of this node, +2 or -2, which is not
+      ///        stored
+      /// @return The root of the tri-node structure after restructring
       ///
       /// Base your algorithm off of Code Fragment 10.12 on page 442 in book
-      ///
-      /// Hint: You can create your own supporting functions to implement
-      ///       code reusability.
-      node* restructure() {
-        /// @todo Implement restructuring
-        node* x = this;
-        node* y = x->parent;
-	      node* z = y->parent;  
-	      node* a = nullptr;
-	      if(z->value.first < y->value.first && y->value.first > x->value.first)
-	      {
-		       y->rotate_right();
-		       a = z->rotate_left();
-	      } 
-	      else if(z->value.first > y->value.first && y->value.first < x->value.first)
-	      {
-		       y->rotate_left();
-		       a = z->rotate_right();
-	      }
-	      else if(z->value.first < y->value.first && y->value.first < x->value.first)
-	      {
-		       a = z->rotate_left();
-	      }
-	      else if(z->value.first > y->value.first && y->value.first > x->value.first)
-	      {
-		       a = z->rotate_right();
-	      }
-        return a;
+      node* restructure(int bal) {
+        node* z = this;
+        node* y = bal > 0 ? z->right : z->left;
+        int yb = y->get_balance();
+        if(yb == 0 || (yb > 0) == (bal > 0)) {
+          // single rotation, y becomes the root
+          if(bal > 0) z->rotate_left();
+          else z->rotate_right();
+          z->set_balance(yb == 0 ? bal / 2 : 0);
+          y->set_balance(yb == 0 ? -bal / 2 : 0);
+          return y;
+        }
+        // double rotation, the grandchild x becomes the root
+        node* x = bal > 0 ? y->left : y->right;
+        int xb = x->get_balance();
+        if(bal > 0) {
+          y->rotate_right();
+          z->rotate_left();
+        }
+        else {
+          y->rotate_left();
+          z->rotate_right();
+        }
+        node* l = bal > 0 ? z : y;
+        node* r = bal > 0 ? y : z;
+        l->set_balance(xb > 0 ? -1 : 0);
+        r->set_balance(xb < 0 ? 1 : 0);
+        x->set_balance(0);
+        return x;
       }
+
       /// @brief Set new left and right children to a node
       /// @param New left and right children
       /// @return Node with the resetted children
       node* set_children(node* l, node *r)  {
         left = l;
         right = r;
-        left->parent = this;
-        right->parent = this;
+        left->set_parent(this);
+        right->set_parent(this);
         return this;
       }
 
-      /// @brief Rotate right a node
+      /// @brief Rotate right a node, balance factors are left to the caller
       /// @return Node structure after right rotation
+      ///
+      /// The policy's rotated() hook sees this node below its new parent.
       node* rotate_right() {
+#ifdef MYSTL_COUNT_ROTATIONS
+        ++rotation_count();
+#endif
         node* p = this;
         node* c = p->left;
         node* s = c->right;
 
-        c->parent = p->parent;
-        if(p == p->parent->left)
-          p->parent->left = c;
+        c->set_parent(p->get_parent());
+        if(p == p->get_parent()->left)
+          p->get_parent()->left = c;
         else
-          p->parent->right = c;
+          p->get_parent()->right = c;
         c->set_children(c->left,p);
         p->set_children(s,p->right);
-        p->set_height();
-        c->set_height();
+        Balance::rotated(p);
         return c;
       }
 
-      /// @brief Rotate left a node
+      /// @brief Rotate left a node, balance factors are left to the caller
       /// @return Node structure after left rotation
+      ///
+      /// The policy's rotated() hook sees this node below its new parent.
       node* rotate_left() {
+#ifdef MYSTL_COUNT_ROTATIONS
+        ++rotation_count();
+#endif
         node* p = this;
         node* c = p->right;
         node* s = c->left;
 
-        c->parent = p->parent;
-        if(p == p->parent->left)
-          p->parent->left = c;
+        c->set_parent(p->get_parent());
+        if(p == p->get_parent()->left)
+          p->get_parent()->left = c;
         else
-          p->parent->right = c;
+          p->get_parent()->right = c;
         c->set_children(p,c->right);
         p->set_children(p->left,s);
-        p->set_height();
-        c->set_height();
+        Balance::rotated(p);
         return c;
       }
 
@@ -612,8 +2607,19 @@ class map {
       /// @name Accessors
       /// @{
 
+      /// @return Parent node
+      node* get_parent() const {
+        return reinterpret_cast<node*>(tag & ~tag_bits);
+      }
+      /// @return Balance factor, height of right minus height of left child
+      int get_balance() const {return int(tag & balance_bits) - 1;}
+      /// @return Allocated from a slab rather than with new
+      bool in_slab() const {return tag & slab_bit;}
+      /// @return Is the node a tombstone left by lazy erase?
+      bool is_dead() const {return tag & dead_bit;}
+
       /// @return If parent is null return true, else false
-      bool is_root() const {return parent == nullptr;}
+      bool is_root() const {return get_parent() == nullptr;}
       /// @return If both children are null return true, else false
       bool is_external() const {return left == nullptr && right == nullptr;}
       /// @return If it is not external then it is internal
@@ -623,12 +2629,16 @@ class map {
       node* leftmost() const {
         const node* n = this;
         while(n->is_internal()) n = n->left;
-        return n->parent;
+        return n->get_parent();
       }
 
       /// @return Next node in the binary tree according to an inorder
       ///         traversal
       node* inorder_next() {
+        //An external node here is an inline entry of a small map, its parent
+        //is the sentinel which links the first and last entry
+        if(is_external())
+          return this == get_parent()->right ? get_parent() : this + 1;
         //Here, I have a right child, so inorder successor is leftmost child
         //of right subtree
         if(right->is_internal()) {
@@ -638,10 +2648,10 @@ class map {
         //who has a right child
         else {
           node* n = this;
-          node* w = parent;
+          node* w = get_parent();
           while(n == w->right) {
             n = w;
-            w = w->parent;
+            w = w->get_parent();
           }
           return w;
         }
@@ -650,21 +2660,26 @@ class map {
       /// @return Previous node in the binary tree according to an inorder
       ///         traversal
       node* inorder_prev() {
+        if(is_external())
+          return this == get_parent()->left ? get_parent() : this - 1;
+        //The sentinel of a small map links the last entry as its right child
+        if(is_root() && left->is_external())
+          return right;
         //Here, I have a left child, so inorder predecessor is rightmost child
         //of left subtree
         if(left->is_internal()) {
           node* n = left;
           while(n->is_internal()) n = n->right;
-          return n->parent;
+          return n->get_parent();
         }
         //Otherwise, I am a left child myself and need to find an ancestor
         //who has a left child
         else {
           node* n = this;
-          node* w = parent;
+          node* w = get_parent();
           while(n == w->left) {
             n = w;
-            w = w->parent;
+            w = w->get_parent();
           }
           return w;
         }
@@ -677,16 +2692,204 @@ class map {
       /// @name Data
       /// @{
 
-      value_type value; ///< Value is pair(key, value)
-      node* parent;     ///< Parent node
+      uintptr_t tag;    ///< Parent node, with the balance factor plus one in
+                        ///< the two low bits, the slab flag in the third and
+                        ///< the tombstone mark in the fourth
       node* left;       ///< Left node
       node* right;      ///< Right node
-      size_t height;    ///< Height of the node (used in AVL trees)
+
+      static constexpr uintptr_t balance_bits = 3;  ///< Balance factor mask
+      static constexpr uintptr_t balance_zero = 1;  ///< Encoded balance of 0
+      static constexpr uintptr_t slab_bit = 4;      ///< Slab flag mask
+      static constexpr uintptr_t dead_bit =
+        Balance::tombstone_percent ? 8 : 0;         ///< Tombstone mask, none
+                                                    ///< without lazy erase
+      static constexpr uintptr_t tag_bits =
+        7 | dead_bit;                               ///< All flag bits
 
       /// @}
       //////////////////////////////////////////////////////////////////////////
     };
 
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Raw storage for the sentinel and inline entries of a small map
+    /// @tparam N Number of inline entries
+    ////////////////////////////////////////////////////////////////////////////
+    template<size_t N, typename = void>
+      struct inline_store {
+        /// @return Sentinel node of the small map
+        node* head() const {return reinterpret_cast<node*>(const_cast<raw*>(&h));}
+        /// @param i Index
+        /// @return Inline entry \c i
+        node* slot(size_t i) const {return reinterpret_cast<node*>(const_cast<raw*>(&s[i]));}
+
+        typedef typename std::aligned_storage<sizeof(node), alignof(node)>::type
+          raw;   ///< Uninitialized node
+        raw h;    ///< Sentinel
+        raw s[N]; ///< Entries, sorted by key
+      };
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief No inline storage when small-size mode is disabled
+    ////////////////////////////////////////////////////////////////////////////
+    template<typename D>
+      struct inline_store<0, D> {
+        /// @return No sentinel
+        node* head() const {return nullptr;}
+        /// @return No entries
+        node* slot(size_t) const {return nullptr;}
+      };
+
+    inline_store<SmallSize> store; ///< Inline storage for small-size mode
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Hashed side index from key to node of a map in tree mode
+    /// @tparam On Is the index enabled
+    ////////////////////////////////////////////////////////////////////////////
+    template<bool On, typename = void>
+      struct side_index {
+        /// @param k Key
+        /// @return Node with key \c k, nullptr if there is none
+        node* find(const Key& k) const {
+          typename std::unordered_map<Key, node*>::const_iterator i = m.find(k);
+          return i == m.end() ? nullptr : i->second;
+        }
+        /// @brief Point a key at a node
+        /// @param k Key
+        /// @param n Node
+        void set(const Key& k, node* n) {m[k] = n;}
+        /// @param k Key to remove
+        void erase(const Key& k) {m.erase(k);}
+        /// @brief Remove all keys
+        void clear() {m.clear();}
+        /// @param n Number of keys to make room for
+        void reserve(size_t n) {m.reserve(n);}
+        /// @return Estimated bytes held by the bucket array and hash nodes
+        size_t memory_usage() const {
+          return m.bucket_count() * sizeof(void*) + m.size() *
+            (sizeof(typename std::unordered_map<Key, node*>::value_type) +
+             2 * sizeof(void*));
+        }
+
+        std::unordered_map<Key, node*> m; ///< Key to node
+      };
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief No side index when disabled
+    ////////////////////////////////////////////////////////////////////////////
+    template<typename D>
+      struct side_index<false, D> {
+        /// @return No node
+        node* find(const Key&) const {return nullptr;}
+        /// @brief Nothing to update
+        void set(const Key&, node*) {}
+        /// @brief Nothing to update
+        void erase(const Key&) {}
+        /// @brief Nothing to update
+        void clear() {}
+        /// @brief Nothing to update
+        void reserve(size_t) {}
+        /// @return No memory
+        size_t memory_usage() const {return 0;}
+      };
+
+    side_index<Indexed> index; ///< Side index for point lookups
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @brief Hands out node memory in address order from aligned slabs
+    ///
+    /// Each slab starts with a header counting its live nodes, found from any
+    /// node by rounding its address down to the slab size. A slab is freed
+    /// once all its nodes are released and no allocator is filling it. The
+    /// allocator never reuses a slot; the map keeps the slots it frees as
+    /// spares for its own new nodes, and only releases them here once they
+    /// outnumber its tree. Until then, and while any node of a slab lives,
+    /// the whole slab stays allocated.
+    ////////////////////////////////////////////////////////////////////////////
+    class slab_allocator {
+      public:
+        /// @brief Constructor
+        slab_allocator() : slab(nullptr), next(nullptr), last(nullptr) {}
+        /// @brief Destructor, stops filling the current slab
+        ~slab_allocator() {if(slab) unref(slab);}
+
+        /// @brief Copy construction - Deleted
+        slab_allocator(const slab_allocator&) = delete;
+        /// @brief Copy assignment - Deleted
+        slab_allocator& operator=(const slab_allocator&) = delete;
+
+        /// @return Memory for one node, following the previous one
+        void* allocate() {
+          if(next == last) refill();
+          slab->live.fetch_add(1, std::memory_order_relaxed);
+          void* p = next;
+          next += sizeof(node);
+          return p;
+        }
+
+        /// @brief Release the memory of a destroyed node
+        /// @param n Node allocated from a slab
+        static void release(node* n) {
+          unref(reinterpret_cast<header*>(slab_of(n)));
+        }
+
+        /// @return Slab size, a power of two holding at least 64 nodes
+        static size_t bytes() {
+          size_t b = 1 << 16;
+          while(b < sizeof(header) + 64 * sizeof(node)) b *= 2;
+          return b;
+        }
+
+        /// @param n Node allocated from a slab
+        /// @return Address of its slab, the same for every node in the slab
+        static std::uintptr_t slab_of(const node* n) {
+          return reinterpret_cast<std::uintptr_t>(n) &
+            ~(std::uintptr_t(bytes()) - 1);
+        }
+
+      private:
+        /// @brief Slab header
+        struct header {
+          std::atomic<size_t> live; ///< Live nodes, plus one while filling
+        };
+
+        /// @brief Start filling a new slab
+        void refill() {
+          if(slab) unref(slab);
+          size_t b = bytes();
+          void* raw = nullptr;
+#ifdef _WIN32
+          raw = _aligned_malloc(b, b);
+#else
+          if(posix_memalign(&raw, b, b) != 0) raw = nullptr;
+#endif
+          if(!raw) throw std::bad_alloc();
+          slab = new (raw) header;
+          slab->live.store(1, std::memory_order_relaxed);
+          size_t off = (sizeof(header) + alignof(node) - 1) / alignof(node) *
+            alignof(node);
+          next = static_cast<char*>(raw) + off;
+          last = next + (b - off) / sizeof(node) * sizeof(node);
+        }
+
+        /// @brief Drop one reference to a slab, freeing it on the last
+        /// @param h Slab header
+        static void unref(header* h) {
+          if(h->live.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            h->~header();
+#ifdef _WIN32
+            _aligned_free(h);
+#else
+            free(h);
+#endif
+          }
+        }
+
+        header* slab; ///< Slab being filled
+        char* next;   ///< Next free node in the slab
+        char* last;   ///< End of usable space in the slab
+    };
+
     ////////////////////////////////////////////////////////////////////////////
     ////////////////////////////////////////////////////////////////////////////
     template<typename U>
@@ -726,9 +2929,9 @@ class map {
           /// @{
 
           /// @brief Dereference operator
-          U& operator*() const {return n->value;}
+          U& operator*() const {return n->entry();}
           /// @brief Dereference operator
-          U* operator->() const {return &n->value;}
+          U* operator->() const {return &n->entry();}
 
           /// @}
           //////////////////////////////////////////////////////////////////////
@@ -738,11 +2941,17 @@ class map {
           /// @{
 
           /// @brief Pre-increment
-          map_iterator& operator++() {n = n->inorder_next(); return *this;}
+          map_iterator& operator++() {
+            do n = n->inorder_next(); while(n->is_dead());
+            return *this;
+          }
           /// @brief Post-increment
           map_iterator operator++(int) {map_iterator tmp(*this); ++(*this); return tmp;}
           /// @brief Pre-decrement
-          map_iterator& operator--() {n = n->inorder_prev(); return *this;}
+          map_iterator& operator--() {
+            do n = n->inorder_prev(); while(n->is_dead());
+            return *this;
+          }
           /// @brief Post-decrement
           map_iterator operator--(int) {map_iterator tmp(*this); --(*this); return tmp;}
 
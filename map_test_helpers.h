@@ -0,0 +1,120 @@
+#ifndef _MAP_TEST_HELPERS_H_
+#define _MAP_TEST_HELPERS_H_
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Integer key counting its comparisons, a cost measure independent of
+///        the machine
+/// @ingroup Testing
+////////////////////////////////////////////////////////////////////////////////
+struct counted_key {
+  int k; ///< Key
+
+  /// @param a Key
+  /// @param b Key
+  /// @return Is \c a ordered before \c b?
+  friend bool operator<(const counted_key& a, const counted_key& b) {
+    ++compares();
+    return a.k < b.k;
+  }
+
+  /// @return Comparisons so far
+  static size_t& compares() {
+    static size_t c = 0;
+    return c;
+  }
+};
+
+/// @brief Set an integer value
+inline void set_test_value(int& v, size_t i) {v = int(i);}
+/// @brief Set a string value
+inline void set_test_value(std::string& v, size_t i) {v = std::to_string(i);}
+
+/// @brief Random operations on a map against std::map
+/// @ingroup Testing
+/// @tparam M Map type with int keys, and int or string values
+/// @param ops Number of operations
+/// @param range Keys are drawn from [0, range)
+/// @param seed Random seed
+/// @return Did every operation agree, and every check of the whole tree
+///         pass, also on a copy and after compact()?
+///
+/// Most keys drawn are missing whenever the map is sparse, so lookups and
+/// erases of missing keys are covered as much as those of present ones.
+template<typename M>
+bool random_against_std_map(size_t ops, int range, unsigned seed) {
+  typedef typename M::mapped_type V;
+  M m;
+  std::map<int, V> s;
+  srand(seed);
+  bool ok = true;
+  for(size_t i = 0; i < ops && ok; ++i) {
+    int k = rand() % range;
+    V v;
+    set_test_value(v, i);
+    switch(rand() % 10) {
+      case 0:
+      case 1: m[k] = v; s[k] = v; break;
+      case 2:
+        // insert is put(k, v), replacing the value of an existing key
+        ok = m.insert(std::make_pair(k, v)).second == (s.count(k) == 0);
+        s[k] = v;
+        break;
+      case 3:
+      case 4: ok = m.erase(k) == s.erase(k); break;
+      case 5: {
+        typename M::iterator j = m.find(k);
+        typename std::map<int, V>::iterator t = s.find(k);
+        ok = (j == m.end()) == (t == s.end());
+        if(ok && t != s.end()) {
+          j = m.erase(j);
+          t = s.erase(t);
+          ok = (j == m.end()) == (t == s.end()) &&
+            (t == s.end() || j->first == t->first);
+        }
+        break;
+      }
+      case 6: {
+        typename M::node_type h = m.extract(k);
+        ok = bool(h) == (s.count(k) == 1);
+        if(ok && h) {
+          int to = rand() % range;
+          h.key() = to;
+          V x = s[k];
+          s.erase(k);
+          ok = m.insert(std::move(h)).inserted ==
+            s.insert(std::make_pair(to, x)).second;
+        }
+        break;
+      }
+      case 7: ok = m.count(k) == s.count(k); break;
+      case 8:
+        try {ok = m.at(k) == s.at(k);}
+        catch(const std::out_of_range&) {ok = s.count(k) == 0;}
+        break;
+      default: {
+        typename M::iterator j = m.find(k);
+        ok = s.count(k) ? j != m.end() && j->second == s[k] :
+          j == m.end();
+      }
+    }
+    ok = ok && m.size() == s.size();
+    if(i % 4096 == 0 && (s.size() < 16384 || i % 65536 == 0))
+      ok = ok && m.valid() && std::equal(s.begin(), s.end(), m.begin());
+  }
+  const M c(m);
+  ok = ok && m.valid() && c.valid() &&
+    std::equal(s.begin(), s.end(), m.begin()) &&
+    std::equal(s.rbegin(), s.rend(), c.crbegin());
+  m.compact();
+  return ok && m.valid() && m.balanced() &&
+    std::equal(s.begin(), s.end(), m.begin());
+}
+
+#endif
@@ -0,0 +1,937 @@
+#ifndef _RADIX_MAP_H_
+#define _RADIX_MAP_H_
+
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#endif
+
+namespace mystl {
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Map ADT for integral keys implemented with an adaptive radix tree
+/// @ingroup MySTL
+/// @tparam Key Integral key type
+/// @tparam Value Value type
+///
+/// Keys are split into their big-endian bytes (with the sign bit flipped for
+/// signed types so byte order matches numeric order) and each byte selects a
+/// child in an inner node. Inner nodes adapt their fan-out to the number of
+/// children (Node4, Node16, Node48, Node256), and a subtree holding a single
+/// key is stored as just its leaf. Lookup cost is therefore bounded by the
+/// key width rather than log n.
+///
+/// Leaves are additionally threaded into a circular doubly linked list in key
+/// order through a sentinel, which gives ordered bidirectional iteration with
+/// the same interface as mystl::map.
+///
+/// Assumes the same as mystl::map: There is always enough memory for
+/// allocations; Functions not well-defined on an empty container will exhibit
+/// undefined behavior.
+////////////////////////////////////////////////////////////////////////////////
+template<typename Key, typename Value>
+class radix_map {
+
+  static_assert(std::is_integral<Key>::value,
+      "radix_map requires an integral key type");
+
+  struct base;           ///< Forward declare node classes
+  struct leaf;
+  struct inner;
+  struct node4;
+  struct node16;
+  struct node48;
+  struct node256;
+  template<typename>
+    class radix_iterator; ///< Forward declare iterator class
+
+  public:
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Types
+    /// @{
+
+    typedef Key key_type;      ///< Public access to Key type
+    typedef Value mapped_type; ///< Public access to Value type
+    typedef std::pair<const key_type, mapped_type>
+      value_type;              ///< Entry type
+    typedef radix_iterator<value_type>
+      iterator;                ///< Bidirectional iterator
+    typedef radix_iterator<const value_type>
+      const_iterator;          ///< Const bidirectional iterator
+    typedef std::reverse_iterator<iterator>
+      reverse_iterator;        ///< Reverse bidirectional iterator
+    typedef std::reverse_iterator<const_iterator>
+      const_reverse_iterator;  ///< Const reverse bidirectional iterator
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Constructors
+    /// @{
+
+    /// @brief Constructor
+    radix_map() : root(nullptr), head(new leaf()), sz(0) {
+      head->prev = head->next = head;
+    }
+    /// @brief Copy constructor
+    /// @param m Other map
+    radix_map(const radix_map& m) : radix_map() {
+      for(leaf* l = m.head->next; l != m.head; l = l->next)
+        inserter(l->value);
+    }
+    /// @brief Destructor
+    ~radix_map() {
+      destroy(root);
+      delete head;
+    }
+
+    /// @brief Copy assignment
+    /// @param m Other map
+    /// @return Reference to self
+    radix_map& operator=(const radix_map& m) {
+      if(this != &m) {
+        clear();
+        for(leaf* l = m.head->next; l != m.head; l = l->next)
+          inserter(l->value);
+      }
+      return *this;
+    }
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Iterators
+    /// @{
+
+    /// @return Iterator to beginning
+    iterator begin() {return iterator(head->next);}
+    /// @return Iterator to end
+    iterator end() {return iterator(head);}
+    /// @return Iterator to reverse beginning
+    reverse_iterator rbegin() {return reverse_iterator(end());}
+    /// @return Iterator to reverse end
+    reverse_iterator rend() {return reverse_iterator(begin());}
+    /// @return Iterator to beginning
+    const_iterator cbegin() const {return const_iterator(head->next);}
+    /// @return Iterator to end
+    const_iterator cend() const {return const_iterator(head);}
+    /// @return Iterator to reverse beginning
+    const_reverse_iterator crbegin() const {return const_reverse_iterator(cend());}
+    /// @return Iterator to reverse end
+    const_reverse_iterator crend() const {return const_reverse_iterator(cbegin());}
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Capacity
+    /// @{
+
+    /// @return Size of map
+    size_t size() const {return sz;}
+    /// @return Does the map contain anything?
+    bool empty() const {return sz == 0;}
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Element Access
+    /// @{
+
+    /// @param k Input key
+    /// @return Value at given key
+    ///
+    /// If \c k is not found in the container, a new element with that key is
+    /// inserted with a default constructed value.
+    Value& operator[](const Key& k) {
+      return inserter(std::make_pair(k, Value())).first->value.second;
+    }
+
+    /// @param k Input key
+    /// @return Value at given key
+    ///
+    /// If \c k is not found in the container, the function throws an
+    /// \c out_of_range exception.
+    Value& at(const Key& k) {
+      leaf* l = finder(k);
+      if(!l) throw std::out_of_range("Error: key is not in the map");
+      return l->value.second;
+    }
+
+    /// @param k Input key
+    /// @return Value at given key
+    ///
+    /// If \c k is not found in the container, the function throws an
+    /// \c out_of_range exception.
+    const Value& at(const Key& k) const {
+      leaf* l = finder(k);
+      if(!l) throw std::out_of_range("Error: key is not in the map");
+      return l->value.second;
+    }
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Modifiers
+    /// @{
+
+    /// @brief Insert element into map
+    /// @param v Key, Value pair
+    /// @return pair of iterator and bool. Iterator pointing to found element or
+    ///         already existing element. bool is true if a new element was
+    ///         inserted and false if it existed.
+    ///
+    /// As with mystl::map, an existing element takes the new value.
+    std::pair<iterator, bool> insert(const value_type& v) {
+      std::pair<leaf*, bool> l = inserter(v);
+      if(!l.second) l.first->value.second = v.second;
+      return std::make_pair(iterator(l.first), l.second);
+    }
+    /// @brief Remove element at specified position
+    /// @param position Position
+    /// @return Position of the element which followed the erased one
+    iterator erase(const_iterator position) {
+      leaf* next = position.n->next;
+      eraser(position.n->value.first);
+      return iterator(next);
+    }
+    /// @brief Remove element with specified key
+    /// @param k Key
+    /// @return Number of elements removed (in this case it is at most 1)
+    size_t erase(const Key& k) {
+      return eraser(k) ? 1 : 0;
+    }
+    /// @brief Removes all elements
+    void clear() noexcept {
+      destroy(root);
+      root = nullptr;
+      head->prev = head->next = head;
+      sz = 0;
+    }
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Operations
+    /// @{
+
+    /// @brief Search the container for an element with key \c k
+    /// @param k Key
+    /// @return Iterator to position if found, end() otherwise
+    iterator find(const Key& k) {
+      leaf* l = finder(k);
+      return l ? iterator(l) : end();
+    }
+
+    /// @brief Search the container for an element with key \c k
+    /// @param k Key
+    /// @return Iterator to position if found, cend() otherwise
+    const_iterator find(const Key& k) const {
+      leaf* l = finder(k);
+      return l ? const_iterator(l) : cend();
+    }
+
+    /// @brief Count elements with specific keys
+    /// @param k Key
+    /// @return Count of elements with key \c k, i.e., 1 or 0
+    size_t count(const Key& k) const {
+      return finder(k) ? 1 : 0;
+    }
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+  private:
+
+    typedef typename std::make_unsigned<Key>::type ukey; ///< Key as bits
+
+    static constexpr size_t width = sizeof(Key); ///< Bytes per key
+
+    /// @brief Node type tags
+    enum : uint8_t {LEAF, N4, N16, N48, N256};
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Key Bytes
+    /// @{
+
+    /// @param k Key
+    /// @return Key bits ordered so unsigned comparison matches key comparison
+    static ukey ordered(const Key& k) {
+      ukey u = ukey(k);
+      if(std::is_signed<Key>::value)
+        u ^= ukey(ukey(1) << (8 * width - 1));
+      return u;
+    }
+
+    /// @param u Ordered key bits
+    /// @param d Depth
+    /// @return Byte of the key used at depth \c d, most significant first
+    static uint8_t byte_at(ukey u, size_t d) {
+      return uint8_t(u >> (8 * (width - 1 - d)));
+    }
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Helpers
+    /// @{
+
+    /// @brief Utility for finding the leaf with Key \c k
+    /// @param k Key
+    /// @return Leaf holding \c k, nullptr if there is none
+    leaf* finder(const Key& k) const {
+      ukey u = ordered(k);
+      base* n = root;
+      for(size_t d = 0; n && n->type != LEAF; ++d) {
+        base** c = find_child(static_cast<inner*>(n), byte_at(u, d));
+        n = c ? *c : nullptr;
+      }
+      if(n && static_cast<leaf*>(n)->value.first == k)
+        return static_cast<leaf*>(n);
+      return nullptr;
+    }
+
+    /// @brief Utility for inserting a new leaf into the data structure.
+    /// @param v Key, Value pair
+    /// @return pair of leaf and bool. leaf holding the new or already existing
+    ///         element. bool is true if a new element was inserted.
+    ///
+    /// A leaf is stored as high in the tree as its key is unique. Inserting
+    /// next to an existing leaf pushes both down under a chain of Node4s
+    /// covering their common key bytes.
+    std::pair<leaf*, bool> inserter(const value_type& v) {
+      ukey u = ordered(v.first);
+      if(!root) {
+        leaf* l = new leaf(v);
+        link_after(head, l);
+        root = l;
+        ++sz;
+        return std::make_pair(l, true);
+      }
+
+      base** ref = &root;
+      for(size_t d = 0; ; ++d) {
+        base* n = *ref;
+        if(n->type == LEAF) {
+          leaf* o = static_cast<leaf*>(n);
+          if(o->value.first == v.first) return std::make_pair(o, false);
+
+          leaf* l = new leaf(v);
+          if(v.first < o->value.first) link_after(o->prev, l);
+          else link_after(o, l);
+
+          ukey ou = ordered(o->value.first);
+          size_t dd = d;
+          while(byte_at(ou, dd) == byte_at(u, dd)) ++dd;
+          base* top = new node4;
+          add_child(&top, static_cast<inner*>(top), byte_at(ou, dd), o);
+          add_child(&top, static_cast<inner*>(top), byte_at(u, dd), l);
+          while(dd > d) {
+            --dd;
+            base* w = new node4;
+            add_child(&w, static_cast<inner*>(w), byte_at(u, dd), top);
+            top = w;
+          }
+          *ref = top;
+          ++sz;
+          return std::make_pair(l, true);
+        }
+
+        inner* in = static_cast<inner*>(n);
+        uint8_t b = byte_at(u, d);
+        base** c = find_child(in, b);
+        if(c) {
+          ref = c;
+          continue;
+        }
+
+        leaf* l = new leaf(v);
+        base* p = child_before(in, b);
+        if(p) link_after(max_leaf(p), l);
+        else link_after(min_leaf(child_after(in, b))->prev, l);
+        add_child(ref, in, b, l);
+        ++sz;
+        return std::make_pair(l, true);
+      }
+    }
+
+    /// @brief Erase the leaf with Key \c k from the tree
+    /// @param k Key
+    /// @return Whether an element was removed
+    ///
+    /// Inner nodes left empty are freed, and an inner node left with a single
+    /// leaf child is replaced by that leaf, repeating toward the root.
+    bool eraser(const Key& k) {
+      if(!root) return false;
+      ukey u = ordered(k);
+      base** refs[width + 1];
+      base** ref = &root;
+      size_t depth = 0;
+      while((*ref)->type != LEAF) {
+        refs[depth] = ref;
+        base** c = find_child(static_cast<inner*>(*ref), byte_at(u, depth));
+        if(!c) return false;
+        ref = c;
+        ++depth;
+      }
+      leaf* l = static_cast<leaf*>(*ref);
+      if(l->value.first != k) return false;
+
+      l->prev->next = l->next;
+      l->next->prev = l->prev;
+      delete l;
+      --sz;
+
+      if(depth == 0) {
+        root = nullptr;
+        return true;
+      }
+      remove_child(refs[depth - 1], static_cast<inner*>(*refs[depth - 1]),
+          byte_at(u, depth - 1));
+      for(size_t i = depth; i-- > 0;) {
+        inner* n = static_cast<inner*>(*refs[i]);
+        if(n->count == 0) {
+          free_node(n);
+          if(i == 0) root = nullptr;
+          else remove_child(refs[i - 1], static_cast<inner*>(*refs[i - 1]),
+              byte_at(u, i - 1));
+        }
+        else if(n->count == 1 && first_child(n)->type == LEAF) {
+          *refs[i] = first_child(n);
+          free_node(n);
+        }
+        else
+          break;
+      }
+      return true;
+    }
+
+    /// @brief Link a leaf into the ordered list
+    /// @param pos Leaf to link after
+    /// @param l New leaf
+    static void link_after(leaf* pos, leaf* l) {
+      l->prev = pos;
+      l->next = pos->next;
+      pos->next->prev = l;
+      pos->next = l;
+    }
+
+    /// @param n Subtree
+    /// @return Smallest leaf in subtree
+    static leaf* min_leaf(base* n) {
+      while(n->type != LEAF) n = first_child(static_cast<inner*>(n));
+      return static_cast<leaf*>(n);
+    }
+
+    /// @param n Subtree
+    /// @return Largest leaf in subtree
+    static leaf* max_leaf(base* n) {
+      while(n->type != LEAF) n = last_child(static_cast<inner*>(n));
+      return static_cast<leaf*>(n);
+    }
+
+    /// @brief Free a single node according to its type
+    /// @param n Node
+    static void free_node(base* n) {
+      switch(n->type) {
+        case LEAF: delete static_cast<leaf*>(n); break;
+        case N4: delete static_cast<node4*>(n); break;
+        case N16: delete static_cast<node16*>(n); break;
+        case N48: delete static_cast<node48*>(n); break;
+        default: delete static_cast<node256*>(n); break;
+      }
+    }
+
+    /// @brief Free a subtree, recursion is bounded by the key width
+    /// @param n Subtree, may be null
+    static void destroy(base* n) {
+      if(!n) return;
+      switch(n->type) {
+        case N4: {
+          node4* p = static_cast<node4*>(n);
+          for(size_t i = 0; i < p->count; ++i) destroy(p->child[i]);
+          break;
+        }
+        case N16: {
+          node16* p = static_cast<node16*>(n);
+          for(size_t i = 0; i < p->count; ++i) destroy(p->child[i]);
+          break;
+        }
+        case N48: {
+          node48* p = static_cast<node48*>(n);
+          for(size_t i = 0; i < 48; ++i) destroy(p->child[i]);
+          break;
+        }
+        case N256: {
+          node256* p = static_cast<node256*>(n);
+          for(size_t i = 0; i < 256; ++i) destroy(p->child[i]);
+          break;
+        }
+      }
+      free_node(n);
+    }
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Inner Node Helpers
+    /// @{
+
+    /// @param n Inner node
+    /// @param b Key byte
+    /// @return Child slot for byte \c b, nullptr if there is none
+    static base** find_child(inner* n, uint8_t b) {
+      switch(n->type) {
+        case N4: {
+          node4* p = static_cast<node4*>(n);
+          for(size_t i = 0; i < p->count; ++i)
+            if(p->keys[i] == b) return &p->child[i];
+          return nullptr;
+        }
+        case N16: {
+          node16* p = static_cast<node16*>(n);
+#if defined(__SSE2__) && defined(__GNUC__)
+          __m128i cmp = _mm_cmpeq_epi8(_mm_set1_epi8(char(b)),
+              _mm_loadu_si128(reinterpret_cast<const __m128i*>(p->keys)));
+          int mask = _mm_movemask_epi8(cmp) & ((1 << p->count) - 1);
+          return mask ? &p->child[__builtin_ctz(mask)] : nullptr;
+#else
+          for(size_t i = 0; i < p->count; ++i)
+            if(p->keys[i] == b) return &p->child[i];
+          return nullptr;
+#endif
+        }
+        case N48: {
+          node48* p = static_cast<node48*>(n);
+          return p->index[b] ? &p->child[p->index[b] - 1] : nullptr;
+        }
+        default: {
+          node256* p = static_cast<node256*>(n);
+          return p->child[b] ? &p->child[b] : nullptr;
+        }
+      }
+    }
+
+    /// @param n Inner node
+    /// @return Child with the smallest key byte
+    static base* first_child(inner* n) {
+      switch(n->type) {
+        case N4: return static_cast<node4*>(n)->child[0];
+        case N16: return static_cast<node16*>(n)->child[0];
+        case N48: {
+          node48* p = static_cast<node48*>(n);
+          for(size_t b = 0; ; ++b)
+            if(p->index[b]) return p->child[p->index[b] - 1];
+        }
+        default: {
+          node256* p = static_cast<node256*>(n);
+          for(size_t b = 0; ; ++b)
+            if(p->child[b]) return p->child[b];
+        }
+      }
+    }
+
+    /// @param n Inner node
+    /// @return Child with the largest key byte
+    static base* last_child(inner* n) {
+      switch(n->type) {
+        case N4: return static_cast<node4*>(n)->child[n->count - 1];
+        case N16: return static_cast<node16*>(n)->child[n->count - 1];
+        case N48: {
+          node48* p = static_cast<node48*>(n);
+          for(size_t b = 256; ; --b)
+            if(p->index[b - 1]) return p->child[p->index[b - 1] - 1];
+        }
+        default: {
+          node256* p = static_cast<node256*>(n);
+          for(size_t b = 256; ; --b)
+            if(p->child[b - 1]) return p->child[b - 1];
+        }
+      }
+    }
+
+    /// @param n Inner node
+    /// @param b Key byte not present in \c n
+    /// @return Child with the largest key byte below \c b, nullptr if none
+    static base* child_before(inner* n, uint8_t b) {
+      switch(n->type) {
+        case N4: {
+          node4* p = static_cast<node4*>(n);
+          for(size_t i = p->count; i-- > 0;)
+            if(p->keys[i] < b) return p->child[i];
+          return nullptr;
+        }
+        case N16: {
+          node16* p = static_cast<node16*>(n);
+          for(size_t i = p->count; i-- > 0;)
+            if(p->keys[i] < b) return p->child[i];
+          return nullptr;
+        }
+        case N48: {
+          node48* p = static_cast<node48*>(n);
+          for(size_t i = b; i-- > 0;)
+            if(p->index[i]) return p->child[p->index[i] - 1];
+          return nullptr;
+        }
+        default: {
+          node256* p = static_cast<node256*>(n);
+          for(size_t i = b; i-- > 0;)
+            if(p->child[i]) return p->child[i];
+          return nullptr;
+        }
+      }
+    }
+
+    /// @param n Inner node
+    /// @param b Key byte not present in \c n
+    /// @return Child with the smallest key byte above \c b, nullptr if none
+    static base* child_after(inner* n, uint8_t b) {
+      switch(n->type) {
+        case N4: {
+          node4* p = static_cast<node4*>(n);
+          for(size_t i = 0; i < p->count; ++i)
+            if(p->keys[i] > b) return p->child[i];
+          return nullptr;
+        }
+        case N16: {
+          node16* p = static_cast<node16*>(n);
+          for(size_t i = 0; i < p->count; ++i)
+            if(p->keys[i] > b) return p->child[i];
+          return nullptr;
+        }
+        case N48: {
+          node48* p = static_cast<node48*>(n);
+          for(size_t i = size_t(b) + 1; i < 256; ++i)
+            if(p->index[i]) return p->child[p->index[i] - 1];
+          return nullptr;
+        }
+        default: {
+          node256* p = static_cast<node256*>(n);
+          for(size_t i = size_t(b) + 1; i < 256; ++i)
+            if(p->child[i]) return p->child[i];
+          return nullptr;
+        }
+      }
+    }
+
+    /// @brief Add a child to an inner node, growing the node when full
+    /// @param ref Slot holding \c n, updated if \c n is replaced
+    /// @param n Inner node
+    /// @param b Key byte not present in \c n
+    /// @param c Child
+    static void add_child(base** ref, inner* n, uint8_t b, base* c) {
+      switch(n->type) {
+        case N4: {
+          node4* p = static_cast<node4*>(n);
+          if(p->count < 4) {
+            sorted_insert(p->keys, p->child, p->count, b, c);
+            return;
+          }
+          node16* g = new node16;
+          std::memcpy(g->keys, p->keys, 4);
+          std::memcpy(g->child, p->child, 4 * sizeof(base*));
+          g->count = 4;
+          *ref = g;
+          delete p;
+          sorted_insert(g->keys, g->child, g->count, b, c);
+          return;
+        }
+        case N16: {
+          node16* p = static_cast<node16*>(n);
+          if(p->count < 16) {
+            sorted_insert(p->keys, p->child, p->count, b, c);
+            return;
+          }
+          node48* g = new node48;
+          for(size_t i = 0; i < 16; ++i) {
+            g->index[p->keys[i]] = uint8_t(i + 1);
+            g->child[i] = p->child[i];
+          }
+          g->count = 16;
+          *ref = g;
+          delete p;
+          n = g;
+        }
+        // fall through
+        case N48: {
+          node48* p = static_cast<node48*>(n);
+          if(p->count < 48) {
+            size_t i = 0;
+            while(p->child[i]) ++i;
+            p->child[i] = c;
+            p->index[b] = uint8_t(i + 1);
+            ++p->count;
+            return;
+          }
+          node256* g = new node256;
+          for(size_t i = 0; i < 256; ++i)
+            if(p->index[i]) g->child[i] = p->child[p->index[i] - 1];
+          g->count = 48;
+          *ref = g;
+          delete p;
+          n = g;
+        }
+        // fall through
+        default: {
+          node256* p = static_cast<node256*>(n);
+          p->child[b] = c;
+          ++p->count;
+        }
+      }
+    }
+
+    /// @brief Remove a child from an inner node, shrinking the node when it
+    ///        falls well below capacity
+    /// @param ref Slot holding \c n, updated if \c n is replaced
+    /// @param n Inner node
+    /// @param b Key byte present in \c n
+    static void remove_child(base** ref, inner* n, uint8_t b) {
+      switch(n->type) {
+        case N4: {
+          node4* p = static_cast<node4*>(n);
+          sorted_remove(p->keys, p->child, p->count, b);
+          return;
+        }
+        case N16: {
+          node16* p = static_cast<node16*>(n);
+          sorted_remove(p->keys, p->child, p->count, b);
+          if(p->count > 3) return;
+          node4* s = new node4;
+          std::memcpy(s->keys, p->keys, p->count);
+          std::memcpy(s->child, p->child, p->count * sizeof(base*));
+          s->count = p->count;
+          *ref = s;
+          delete p;
+          return;
+        }
+        case N48: {
+          node48* p = static_cast<node48*>(n);
+          p->child[p->index[b] - 1] = nullptr;
+          p->index[b] = 0;
+          if(--p->count > 12) return;
+          node16* s = new node16;
+          for(size_t i = 0; i < 256; ++i)
+            if(p->index[i]) {
+              s->keys[s->count] = uint8_t(i);
+              s->child[s->count++] = p->child[p->index[i] - 1];
+            }
+          *ref = s;
+          delete p;
+          return;
+        }
+        default: {
+          node256* p = static_cast<node256*>(n);
+          p->child[b] = nullptr;
+          if(--p->count > 37) return;
+          node48* s = new node48;
+          for(size_t i = 0; i < 256; ++i)
+            if(p->child[i]) {
+              s->child[s->count] = p->child[i];
+              s->index[i] = uint8_t(++s->count);
+            }
+          *ref = s;
+          delete p;
+          return;
+        }
+      }
+    }
+
+    /// @brief Insert into the sorted key and child arrays of a Node4/Node16
+    /// @param keys Key bytes
+    /// @param child Children
+    /// @param count Number of children, incremented
+    /// @param b Key byte
+    /// @param c Child
+    static void sorted_insert(uint8_t* keys, base** child, uint16_t& count,
+        uint8_t b, base* c) {
+      size_t i = count;
+      for(; i > 0 && keys[i - 1] > b; --i) {
+        keys[i] = keys[i - 1];
+        child[i] = child[i - 1];
+      }
+      keys[i] = b;
+      child[i] = c;
+      ++count;
+    }
+
+    /// @brief Remove from the sorted key and child arrays of a Node4/Node16
+    /// @param keys Key bytes
+    /// @param child Children
+    /// @param count Number of children, decremented
+    /// @param b Key byte
+    static void sorted_remove(uint8_t* keys, base** child, uint16_t& count,
+        uint8_t b) {
+      size_t i = 0;
+      while(keys[i] != b) ++i;
+      for(--count; i < count; ++i) {
+        keys[i] = keys[i + 1];
+        child[i] = child[i + 1];
+      }
+    }
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Data
+    /// @{
+
+    base* root;     ///< Root of the radix tree, nullptr when empty
+    leaf* head;     ///< Sentinel of the ordered leaf list, the end iterator
+    size_t sz;      ///< Number of leaves
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Types
+    /// @{
+
+    /// @brief Common header of all nodes
+    struct base {
+      /// @brief Constructor
+      /// @param t Node type tag
+      explicit base(uint8_t t) : type(t) {}
+      uint8_t type; ///< Node type tag
+    };
+
+    /// @brief Leaf holding a single entry
+    struct leaf : base {
+      /// @brief Constructor
+      /// @param v Map entry (Key, Value) pair
+      leaf(const value_type& v = value_type()) :
+        base(LEAF), value(v), prev(nullptr), next(nullptr) {}
+      value_type value; ///< Value is pair(key, value)
+      leaf* prev;       ///< Previous leaf in key order
+      leaf* next;       ///< Next leaf in key order
+    };
+
+    /// @brief Common header of inner nodes
+    struct inner : base {
+      /// @brief Constructor
+      /// @param t Node type tag
+      explicit inner(uint8_t t) : base(t), count(0) {}
+      uint16_t count; ///< Number of children
+    };
+
+    /// @brief Inner node with up to 4 children, sorted by key byte
+    struct node4 : inner {
+      node4() : inner(N4) {std::memset(keys, 0, sizeof(keys));}
+      uint8_t keys[4];  ///< Key bytes
+      base* child[4];   ///< Children
+    };
+
+    /// @brief Inner node with up to 16 children, sorted by key byte
+    struct node16 : inner {
+      node16() : inner(N16) {std::memset(keys, 0, sizeof(keys));}
+      uint8_t keys[16]; ///< Key bytes
+      base* child[16];  ///< Children
+    };
+
+    /// @brief Inner node with up to 48 children, indexed by key byte
+    struct node48 : inner {
+      node48() : inner(N48) {
+        std::memset(index, 0, sizeof(index));
+        for(size_t i = 0; i < 48; ++i) child[i] = nullptr;
+      }
+      uint8_t index[256]; ///< Slot + 1 of the child per key byte, 0 if none
+      base* child[48];    ///< Children
+    };
+
+    /// @brief Inner node with a child per key byte
+    struct node256 : inner {
+      node256() : inner(N256) {
+        for(size_t i = 0; i < 256; ++i) child[i] = nullptr;
+      }
+      base* child[256]; ///< Children, nullptr if none
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    ////////////////////////////////////////////////////////////////////////////
+    template<typename U>
+      class radix_iterator : public std::iterator<std::bidirectional_iterator_tag, U> {
+        public:
+          //////////////////////////////////////////////////////////////////////
+          /// @name Constructors
+          /// @{
+
+          /// @brief Construction
+          /// @param v Pointer to leaf
+          radix_iterator(leaf* v = nullptr) : n(v) {}
+
+          /// @brief Copy construction
+          /// @param i Other iterator
+          radix_iterator(const radix_iterator<typename std::remove_const<U>::type>& i) : n(i.n) {}
+
+          /// @}
+          //////////////////////////////////////////////////////////////////////
+
+          //////////////////////////////////////////////////////////////////////
+          /// @name Comparison
+          /// @{
+
+          /// @brief Equality comparison
+          /// @param i Iterator
+          bool operator==(const radix_iterator& i) const {return n == i.n;}
+          /// @brief Inequality comparison
+          /// @param i Iterator
+          bool operator!=(const radix_iterator& i) const {return n != i.n;}
+
+          /// @}
+          //////////////////////////////////////////////////////////////////////
+
+          //////////////////////////////////////////////////////////////////////
+          /// @name Dereference
+          /// @{
+
+          /// @brief Dereference operator
+          U& operator*() const {return n->value;}
+          /// @brief Dereference operator
+          U* operator->() const {return &n->value;}
+
+          /// @}
+          //////////////////////////////////////////////////////////////////////
+
+          //////////////////////////////////////////////////////////////////////
+          /// @name Advancement
+          /// @{
+
+          /// @brief Pre-increment
+          radix_iterator& operator++() {n = n->next; return *this;}
+          /// @brief Post-increment
+          radix_iterator operator++(int) {radix_iterator tmp(*this); ++(*this); return tmp;}
+          /// @brief Pre-decrement
+          radix_iterator& operator--() {n = n->prev; return *this;}
+          /// @brief Post-decrement
+          radix_iterator operator--(int) {radix_iterator tmp(*this); --(*this); return tmp;}
+
+          /// @}
+          //////////////////////////////////////////////////////////////////////
+
+          leaf* n; ///< Map leaf
+
+          friend class radix_map;
+      };
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+};
+
+}
+
+#endif
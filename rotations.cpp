@@ -0,0 +1,37 @@
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Rotation counts of the balancing policies, built apart from timing
+///        since counting rotations slows every one of them down
+////////////////////////////////////////////////////////////////////////////////
+
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#define MYSTL_COUNT_ROTATIONS
+#include "workloads.h"
+
+using namespace std;
+
+/// @brief Report rotations per update of insert_erase_n_random
+/// @tparam Balance Balancing policy of the map
+/// @param n Input size
+/// @param name Name of the policy for nice output
+template<typename Balance>
+void report_rotations(size_t n, string name) {
+  mystl::rotation_count() = 0;
+  size_t updates = insert_erase_n_random<Balance>(n);
+  cout << setw(15) << name << setw(15) << n << setw(15) << updates
+    << setw(20) << double(mystl::rotation_count()) / updates << endl;
+}
+
+/// @brief Main function reporting the rotations of each policy
+int main() {
+  cout << "Rotations on random inserts and erases" << endl;
+  cout << setw(15) << "Policy" << setw(15) << "Size" << setw(15) << "Updates"
+    << setw(20) << "Rotations/update" << endl;
+  for(size_t n = 1 << 10; n <= 1 << 20; n <<= 5) {
+    report_rotations<mystl::avl_policy>(n, "AVL");
+    report_rotations<mystl::wavl_policy>(n, "WAVL");
+    report_rotations<mystl::treap_policy>(n, "treap");
+  }
+}
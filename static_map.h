@@ -0,0 +1,429 @@
+#ifndef _STATIC_MAP_H_
+#define _STATIC_MAP_H_
+
+#include <cstddef>
+#include <iterator>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace mystl {
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief String key usable in constant expressions, a view of characters it
+///        does not own
+/// @ingroup MySTL
+///
+/// Ordered like \c std::string. Runtime strings convert implicitly for
+/// lookups, and must outlive the view.
+////////////////////////////////////////////////////////////////////////////////
+class literal_string {
+  public:
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Constructors
+    /// @{
+
+    /// @brief Constructor, the empty string
+    constexpr literal_string() : p(""), n(0) {}
+    /// @brief Constructor from a null terminated string
+    /// @param s String
+    constexpr literal_string(const char* s) : p(s), n(length(s)) {}
+    /// @brief Constructor from characters and a length
+    /// @param s Characters
+    /// @param len Length
+    constexpr literal_string(const char* s, size_t len) : p(s), n(len) {}
+    /// @brief Constructor viewing a standard string
+    /// @param s String
+    literal_string(const std::string& s) : p(s.data()), n(s.size()) {}
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Accessors
+    /// @{
+
+    /// @return Length
+    constexpr size_t size() const {return n;}
+    /// @return Characters, not necessarily null terminated
+    constexpr const char* data() const {return p;}
+    /// @return Copy as a standard string
+    std::string str() const {return std::string(p, n);}
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Comparisons
+    /// @{
+
+    /// @param a String
+    /// @param b String
+    /// @return Is \c a ordered before \c b?
+    friend constexpr bool operator<(const literal_string& a,
+        const literal_string& b) {
+      return compare(a.p, a.n, b.p, b.n) < 0;
+    }
+    /// @param a String
+    /// @param b String
+    /// @return Are the strings equal?
+    friend constexpr bool operator==(const literal_string& a,
+        const literal_string& b) {
+      return compare(a.p, a.n, b.p, b.n) == 0;
+    }
+    /// @param a String
+    /// @param b String
+    /// @return Are the strings different?
+    friend constexpr bool operator!=(const literal_string& a,
+        const literal_string& b) {
+      return !(a == b);
+    }
+
+    /// @brief Output the characters
+    /// @param os Output stream
+    /// @param s String
+    /// @return \c os
+    friend std::ostream& operator<<(std::ostream& os, const literal_string& s) {
+      return os.write(s.p, s.n);
+    }
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+  private:
+
+    /// @param s Null terminated string
+    /// @return Length of \c s
+    static constexpr size_t length(const char* s) {
+      return *s ? 1 + length(s + 1) : 0;
+    }
+
+    /// @param a First string
+    /// @param na Length of \c a
+    /// @param b Second string
+    /// @param nb Length of \c b
+    /// @return Negative, zero or positive in the order of \c std::string
+    static constexpr int compare(const char* a, size_t na, const char* b,
+        size_t nb) {
+      return na == 0 || nb == 0 ? (na == nb ? 0 : na == 0 ? -1 : 1) :
+        *a != *b ? ((unsigned char)*a < (unsigned char)*b ? -1 : 1) :
+        compare(a + 1, na - 1, b + 1, nb - 1);
+    }
+
+    const char* p; ///< Characters
+    size_t n;      ///< Length
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Map ADT for a fixed table, sorted and searched in constant
+///        expressions
+/// @ingroup MySTL
+/// @tparam Key Key type, a literal type with a constexpr \c operator<
+/// @tparam Value Value type, a literal type
+/// @tparam N Number of entries
+///
+/// The entries are sorted into an array by the constructor, so a \c constexpr
+/// table is laid out by the compiler: no code runs at startup and nothing is
+/// allocated. Lookups are binary searches and can themselves be constant
+/// expressions. Duplicate keys make the constructor fail to compile in
+/// constant expressions, and throw \c invalid_argument otherwise.
+///
+/// Being C++11, the sort is written without loops: a bottom-up merge sort of
+/// entry positions, where each pass fills every slot at once by binary
+/// searching how many entries of each of the two runs merged into it come
+/// before that slot. That is O(N log^2 N) comparisons during compilation,
+/// and both the template recursion building the slots and the constexpr
+/// recursion of the sort are O(log N) deep, so tables of thousands of
+/// entries stay within the compilers' default limits.
+////////////////////////////////////////////////////////////////////////////////
+template<typename Key, typename Value, size_t N>
+class static_map {
+
+  static_assert(N > 0, "static_map needs at least one entry");
+
+  public:
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Types
+    /// @{
+
+    typedef Key key_type;      ///< Public access to Key type
+    typedef Value mapped_type; ///< Public access to Value type
+    typedef std::pair<const key_type, mapped_type>
+      value_type;              ///< Entry type, pair(key, value)
+    typedef const value_type*
+      iterator;                ///< Iterator, entries cannot be changed
+    typedef const value_type*
+      const_iterator;          ///< Const iterator
+    typedef std::reverse_iterator<const_iterator>
+      reverse_iterator;        ///< Reverse iterator
+    typedef std::reverse_iterator<const_iterator>
+      const_reverse_iterator;  ///< Const reverse iterator
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Constructors
+    /// @{
+
+    /// @brief Constructor sorting entries given in any order
+    /// @param e Entries, with unique keys
+    constexpr static_map(const value_type (&e)[N]) :
+      static_map(e, sorted(e, identity(typename indices<N>::type()), 1,
+          typename indices<N>::type()), typename indices<N>::type()) {}
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Iterators
+    /// @{
+
+    /// @return Iterator to the smallest key
+    constexpr const_iterator begin() const {return entries;}
+    /// @return Iterator past the largest key
+    constexpr const_iterator end() const {return entries + N;}
+    /// @return Iterator to the smallest key
+    constexpr const_iterator cbegin() const {return begin();}
+    /// @return Iterator past the largest key
+    constexpr const_iterator cend() const {return end();}
+    /// @return Reverse iterator to the largest key
+    const_reverse_iterator rbegin() const {return const_reverse_iterator(end());}
+    /// @return Reverse iterator past the smallest key
+    const_reverse_iterator rend() const {return const_reverse_iterator(begin());}
+    /// @return Reverse iterator to the largest key
+    const_reverse_iterator crbegin() const {return rbegin();}
+    /// @return Reverse iterator past the smallest key
+    const_reverse_iterator crend() const {return rend();}
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Capacity
+    /// @{
+
+    /// @return Number of entries
+    constexpr size_t size() const {return N;}
+    /// @return Always false, a static map has entries
+    constexpr bool empty() const {return false;}
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Element Access
+    /// @{
+
+    /// @param k Input key
+    /// @return Value at given key
+    ///
+    /// If \c k is not found in the map, the function throws an
+    /// \c out_of_range exception, which fails compilation in constant
+    /// expressions.
+    constexpr const Value& at(const Key& k) const {
+      return find(k) != end() ? find(k)->second :
+        throw std::out_of_range("Error: key is not in the map");
+    }
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Operations
+    /// @{
+
+    /// @brief Search the map for an element with key \c k
+    /// @param k Key
+    /// @return Iterator to position if found, end() otherwise
+    constexpr const_iterator find(const Key& k) const {
+      return at_key(lower(k, 0, N), k) ? entries + lower(k, 0, N) : end();
+    }
+
+    /// @param k Key
+    /// @return Count of elements with key \c k, 1 or 0
+    constexpr size_t count(const Key& k) const {
+      return find(k) != end() ? 1 : 0;
+    }
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+  private:
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Helpers
+    /// @{
+
+    /// @brief Compile time list of indices
+    template<size_t... I>
+      struct index_list {};
+    /// @brief Appends a list to another, shifted past its end
+    template<typename A, typename B>
+      struct join;
+    /// @brief Appends a list to another, shifted past its end
+    template<size_t... I, size_t... J>
+      struct join<index_list<I...>, index_list<J...>> {
+        typedef index_list<I..., sizeof...(I) + J...> type; ///< The list
+      };
+    /// @brief Builds index_list<0, ..., M - 1> from its halves, so the
+    ///        instantiations nest O(log M) deep
+    template<size_t M, bool Small = (M < 2)>
+      struct indices {
+        typedef typename join<typename indices<M / 2>::type,
+          typename indices<M - M / 2>::type>::type type; ///< The list
+      };
+    /// @brief Builds index_list<0, ..., M - 1>
+    template<size_t M>
+      struct indices<M, true> {
+        typedef typename std::conditional<M == 0, index_list<>,
+          index_list<0>>::type type; ///< The list
+      };
+
+    /// @brief Positions of the entries, as sorted so far
+    struct order {
+      size_t p[N]; ///< Entry in each slot
+    };
+
+    /// @brief Constructor from entries and their sorted order
+    /// @param e Entries
+    /// @param o Entry of each slot, sorted by key
+    template<size_t... I>
+    constexpr static_map(const value_type (&e)[N], const order& o,
+        index_list<I...>) :
+      entries{unique(e, o, I)...} {}
+
+    /// @return Every entry in its own slot
+    template<size_t... I>
+    static constexpr order identity(index_list<I...>) {
+      return order{{I...}};
+    }
+
+    /// @param e Entries
+    /// @param o Entry of each slot, sorted by key
+    /// @param i Slot
+    /// @return Entry of slot \c i, checked against the next slot's
+    static constexpr const value_type& unique(const value_type (&e)[N],
+        const order& o, size_t i) {
+      return i + 1 == N || e[o.p[i]].first < e[o.p[i + 1]].first ?
+        e[o.p[i]] :
+        throw std::invalid_argument("Error: duplicate key in static_map");
+    }
+
+    /// @param e Entries
+    /// @param o Entry of each slot, sorted in runs of \c w slots
+    /// @param w Run length
+    /// @param l Slots
+    /// @return Entry of each slot, sorted by key
+    template<size_t... I>
+    static constexpr order sorted(const value_type (&e)[N], const order& o,
+        size_t w, index_list<I...> l) {
+      return w >= N ? o : sorted(e, order{{merged(e, o, w, I)...}}, 2 * w, l);
+    }
+
+    /// @param e Entries
+    /// @param o Entry of each slot, sorted in runs of \c w slots
+    /// @param w Run length
+    /// @param i Slot
+    /// @return Entry of slot \c i once pairs of runs are merged
+    static constexpr size_t merged(const value_type (&e)[N], const order& o,
+        size_t w, size_t i) {
+      return merge_at(e, o, i - i % (2 * w), least(i - i % (2 * w) + w, N),
+          least(i - i % (2 * w) + 2 * w, N), i % (2 * w));
+    }
+
+    /// @param e Entries
+    /// @param o Entry of each slot
+    /// @param b First slot of the first run
+    /// @param m First slot of the second run, one past the first
+    /// @param h One past the last slot of the second run
+    /// @param k Slot of the merged runs
+    /// @return Entry of slot \c k of the merged runs
+    static constexpr size_t merge_at(const value_type (&e)[N], const order& o,
+        size_t b, size_t m, size_t h, size_t k) {
+      return pick(e, o, b, m, h, k, taken(e, o, b, m, h, k,
+          k > h - m ? k - (h - m) : 0, least(k, m - b)));
+    }
+
+    /// @param e Entries
+    /// @param o Entry of each slot
+    /// @param b First slot of the first run
+    /// @param m First slot of the second run
+    /// @param h One past the last slot of the second run
+    /// @param k Slot of the merged runs
+    /// @param lo Fewest entries of the first run that may precede slot \c k
+    /// @param hi Most entries of the first run that may precede slot \c k
+    /// @return Entries of the first run preceding slot \c k: the most whose
+    ///         last is still ordered before the second run's next entry
+    static constexpr size_t taken(const value_type (&e)[N], const order& o,
+        size_t b, size_t m, size_t h, size_t k, size_t lo, size_t hi) {
+      return lo == hi ? lo :
+        k - (lo + hi + 1) / 2 == h - m ||
+        e[o.p[b + (lo + hi + 1) / 2 - 1]].first <
+          e[o.p[m + k - (lo + hi + 1) / 2]].first ?
+        taken(e, o, b, m, h, k, (lo + hi + 1) / 2, hi) :
+        taken(e, o, b, m, h, k, lo, (lo + hi + 1) / 2 - 1);
+    }
+
+    /// @param e Entries
+    /// @param o Entry of each slot
+    /// @param b First slot of the first run
+    /// @param m First slot of the second run
+    /// @param h One past the last slot of the second run
+    /// @param k Slot of the merged runs
+    /// @param a Entries of the first run preceding slot \c k
+    /// @return Smaller of the next entries of the two runs
+    static constexpr size_t pick(const value_type (&e)[N], const order& o,
+        size_t b, size_t m, size_t h, size_t k, size_t a) {
+      return m + k - a == h || (b + a < m &&
+          e[o.p[b + a]].first < e[o.p[m + k - a]].first) ?
+        o.p[b + a] : o.p[m + k - a];
+    }
+
+    /// @return Smaller of \c a and \c b
+    static constexpr size_t least(size_t a, size_t b) {
+      return a < b ? a : b;
+    }
+
+    /// @param k Key
+    /// @param lo First entry of the range
+    /// @param hi One past the last entry of the range
+    /// @return First entry in [lo, hi) whose key is not less than \c k
+    constexpr size_t lower(const Key& k, size_t lo, size_t hi) const {
+      return lo == hi ? lo :
+        entries[lo + (hi - lo) / 2].first < k ?
+        lower(k, lo + (hi - lo) / 2 + 1, hi) : lower(k, lo, lo + (hi - lo) / 2);
+    }
+
+    /// @param i Entry, N for none
+    /// @param k Key
+    /// @return Does entry \c i have key \c k?
+    constexpr bool at_key(size_t i, const Key& k) const {
+      return i != N && !(k < entries[i].first);
+    }
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    value_type entries[N]; ///< Entries sorted by key
+};
+
+/// @brief Build a static map, deducing the number of entries
+/// @tparam Key Key type
+/// @tparam Value Value type
+/// @tparam N Number of entries
+/// @param e Entries, with unique keys
+/// @return Map of the entries
+template<typename Key, typename Value, size_t N>
+constexpr static_map<Key, Value, N> make_static_map(
+    const std::pair<const Key, Value> (&e)[N]) {
+  return static_map<Key, Value, N>(e);
+}
+
+}
+
+#endif
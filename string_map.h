@@ -0,0 +1,350 @@
+#ifndef _STRING_MAP_H_
+#define _STRING_MAP_H_
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "map.h"
+
+namespace mystl {
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Immutable string key one pointer wide, front coded against the
+///        neighbouring key it was inserted next to
+/// @ingroup MySTL
+///
+/// The bytes live in a reference counted block holding the length and the
+/// bytes. Copies share the block, so copying a map copies no key bytes. The
+/// empty string holds no block at all, so the external leaves of a map cost
+/// one null pointer instead of a whole \c std::string.
+///
+/// When a map inserts a key it calls share_prefix() with the key next to it
+/// in order, and the key drops the prefix it shares with that neighbour for a
+/// reference to the block holding it. Only blocks without a prefix of their
+/// own are referenced, so a key is at most two pieces: a prefix in another
+/// block and its own suffix. A referenced block outlives the key that made it
+/// until every key sharing it is gone. Keys with long common prefixes, such
+/// as URLs and hierarchical names, then store little more than their
+/// distinct tails; see key_bytes() for what each key holds.
+///
+/// The length is stored in 32 bits, so strings of 4 GiB or more are rejected
+/// with \c length_error.
+////////////////////////////////////////////////////////////////////////////////
+class compact_string {
+  public:
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Constructors
+    /// @{
+
+    /// @brief Constructor, the empty string
+    compact_string() : p(nullptr) {}
+    /// @brief Constructor from a null terminated string
+    /// @param s String
+    compact_string(const char* s) : p(make(s, std::strlen(s))) {}
+    /// @brief Constructor from a standard string
+    /// @param s String
+    compact_string(const std::string& s) : p(make(s.data(), s.size())) {}
+    /// @brief Constructor from bytes and a length
+    /// @param s Bytes
+    /// @param n Length
+    compact_string(const char* s, size_t n) : p(make(s, n)) {}
+    /// @brief Copy constructor, shares the block
+    /// @param s Other string
+    compact_string(const compact_string& s) : p(s.p) {if(p) ++p->refs;}
+    /// @brief Move constructor
+    /// @param s Other string, left empty
+    compact_string(compact_string&& s) noexcept : p(s.p) {s.p = nullptr;}
+    /// @brief Destructor
+    ~compact_string() {release(p);}
+
+    /// @brief Copy assignment
+    /// @param s Other string
+    /// @return Reference to self
+    compact_string& operator=(const compact_string& s) {
+      compact_string t(s);
+      std::swap(p, t.p);
+      return *this;
+    }
+    /// @brief Move assignment
+    /// @param s Other string, left empty
+    /// @return Reference to self
+    compact_string& operator=(compact_string&& s) noexcept {
+      std::swap(p, s.p);
+      return *this;
+    }
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Accessors
+    /// @{
+
+    /// @return Length in bytes
+    size_t size() const {return p ? p->size : 0;}
+    /// @return Is the string empty?
+    bool empty() const {return p == nullptr;}
+    /// @param i Position, less than size()
+    /// @return Byte at position \c i
+    char operator[](size_t i) const {
+      size_t run;
+      return *piece(i, run);
+    }
+    /// @return Copy as a standard string
+    std::string str() const {
+      if(!p) return std::string();
+      std::string s(p->prefix ? p->prefix->bytes() : "", p->shared);
+      return s.append(p->bytes(), p->size - p->shared);
+    }
+    /// @return Copy as a standard string
+    operator std::string() const {return str();}
+    /// @return FNV-1a hash of the bytes
+    size_t hash() const {
+      uint64_t h = 14695981039346656037ull;
+      for(size_t i = 0, run = 0; i < size(); i += run) {
+        const char* b = piece(i, run);
+        for(size_t j = 0; j < run; ++j) {
+          h ^= (unsigned char)b[j];
+          h *= 1099511628211ull;
+        }
+      }
+      return size_t(h);
+    }
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+    ////////////////////////////////////////////////////////////////////////////
+    /// @name Comparisons
+    /// @{
+
+    /// @param a String
+    /// @param b String
+    /// @return Are the strings equal?
+    friend bool operator==(const compact_string& a, const compact_string& b) {
+      size_t l = 0;
+      return a.p == b.p || (a.size() == b.size() && compare(a, b, l) == 0);
+    }
+    /// @param a String
+    /// @param b String
+    /// @return Are the strings different?
+    friend bool operator!=(const compact_string& a, const compact_string& b) {
+      return !(a == b);
+    }
+    /// @param a String
+    /// @param b String
+    /// @return Is \c a ordered before \c b, in the order of \c std::string?
+    friend bool operator<(const compact_string& a, const compact_string& b) {
+      size_t l = 0;
+      return compare(a, b, l) < 0;
+    }
+    /// @param a String
+    /// @param b String
+    /// @return Is \c a ordered after \c b?
+    friend bool operator>(const compact_string& a, const compact_string& b) {
+      return b < a;
+    }
+    /// @param a String
+    /// @param b String
+    /// @return Is \c a not ordered after \c b?
+    friend bool operator<=(const compact_string& a, const compact_string& b) {
+      return !(b < a);
+    }
+    /// @param a String
+    /// @param b String
+    /// @return Is \c a not ordered before \c b?
+    friend bool operator>=(const compact_string& a, const compact_string& b) {
+      return !(a < b);
+    }
+
+    /// @brief Three-way comparison skipping a shared prefix, used by finder
+    /// @param a Key
+    /// @param b Key
+    /// @param lcp Length of a prefix known to be shared, set to the full
+    ///        common prefix length
+    /// @return Negative, zero or positive as \c a is less than, equal to or
+    ///         greater than \c b
+    friend int compare_keys(const compact_string& a, const compact_string& b,
+        size_t& lcp) {
+      return compare(a, b, lcp);
+    }
+
+    /// @brief Front code a key newly inserted into a map against the key next
+    ///        to it, keeping its value
+    /// @param k New key, left as is unless it holds all its bytes itself
+    /// @param near Key adjacent to \c k in the map
+    ///
+    /// Prefixes shorter than a block header are not worth a reference. When
+    /// \c near can only lend a prefix more than 4 bytes shorter than the one
+    /// they have in common, \c k keeps all its bytes instead, becoming a
+    /// block that lends more to the keys inserted next to it.
+    friend void share_prefix(const compact_string& k,
+        const compact_string& near) {
+      if(!k.p || k.p->prefix || !near.p) return;
+      size_t l = 0;
+      compare(k, near, l);
+      block* root = near.p->prefix ? near.p->prefix : near.p;
+      size_t s = near.p->prefix && near.p->shared < l ? near.p->shared : l;
+      if(s < sizeof(block) || s + 4 < l) return;
+      block* b = make(k.p->bytes() + s, k.p->size - s, root, s);
+      release(k.p);
+      k.p = b;
+    }
+
+    /// @param s String
+    /// @return Heap bytes held by \c s alone, excluding any prefix it shares
+    ///
+    /// A block shared as a prefix counts for the key that made it, and for
+    /// none once that key is gone.
+    friend size_t key_bytes(const compact_string& s) {
+      return s.p ? sizeof(block) + s.p->size - s.p->shared : 0;
+    }
+
+    /// @brief Output the bytes
+    /// @param os Output stream
+    /// @param s String
+    /// @return \c os
+    friend std::ostream& operator<<(std::ostream& os, const compact_string& s) {
+      for(size_t i = 0, run = 0; i < s.size(); i += run) {
+        const char* b = s.piece(i, run);
+        os.write(b, run);
+      }
+      return os;
+    }
+
+    /// @}
+    ////////////////////////////////////////////////////////////////////////////
+
+  private:
+
+    /// @brief Reference counted bytes, followed in memory by the suffix
+    struct block {
+      std::atomic<uint32_t> refs; ///< Strings holding the block, directly or
+                                  ///< as their prefix
+      uint32_t size;              ///< Length of the whole string
+      uint32_t shared;            ///< Length of the prefix held in \c prefix
+      block* prefix;              ///< Block whose first bytes start the
+                                  ///< string, nullptr if none
+      /// @return Bytes after the prefix
+      const char* bytes() const {
+        return reinterpret_cast<const char*>(this + 1);
+      }
+    };
+
+    /// @brief Allocate a block
+    /// @param s Bytes after the prefix
+    /// @param n Length of \c s
+    /// @param prefix Block holding the prefix, taken a reference to, or
+    ///        nullptr
+    /// @param shared Length of the prefix
+    /// @return Block, nullptr for the empty string
+    ///
+    /// Throws \c length_error if the length does not fit in 32 bits.
+    static block* make(const char* s, size_t n, block* prefix = nullptr,
+        size_t shared = 0) {
+      if(n + shared == 0) return nullptr;
+      if(n + shared > UINT32_MAX)
+        throw std::length_error("Error: compact_string of 4 GiB or more");
+      block* b = new (::operator new(sizeof(block) + n)) block;
+      b->refs = 1;
+      b->size = uint32_t(n + shared);
+      b->shared = uint32_t(shared);
+      b->prefix = prefix;
+      if(prefix) ++prefix->refs;
+      std::memcpy(const_cast<char*>(b->bytes()), s, n);
+      return b;
+    }
+
+    /// @brief Drop a reference to a block, freeing it and then its prefix
+    ///        once unreferenced
+    /// @param b Block, or nullptr
+    static void release(block* b) {
+      if(!b || --b->refs) return;
+      block* prefix = b->prefix;
+      b->~block();
+      ::operator delete(b);
+      release(prefix);
+    }
+
+    /// @param i Position, less than size()
+    /// @param run Output, number of bytes contiguous from position \c i
+    /// @return Pointer to the byte at position \c i
+    const char* piece(size_t i, size_t& run) const {
+      if(i < p->shared) {
+        run = p->shared - i;
+        return p->prefix->bytes() + i;
+      }
+      run = p->size - i;
+      return p->bytes() + (i - p->shared);
+    }
+
+    /// @param a String
+    /// @param b String
+    /// @param lcp Length of a prefix known to be shared, set to the full
+    ///        common prefix length
+    /// @return Negative, zero or positive in the order of \c std::string
+    ///
+    /// Compares piece by piece, each piece with compare_bytes.
+    static int compare(const compact_string& a, const compact_string& b,
+        size_t& lcp) {
+      size_t na = a.size(), nb = b.size();
+      size_t n = na < nb ? na : nb;
+      while(lcp < n) {
+        size_t ra, rb;
+        const char* x = a.piece(lcp, ra);
+        const char* y = b.piece(lcp, rb);
+        size_t m = ra < rb ? ra : rb;
+        size_t l = 0;
+        int c = compare_bytes(x, m, y, m, l);
+        lcp += l;
+        if(c) return c;
+      }
+      return na < nb ? -1 : na > nb ? 1 : 0;
+    }
+
+    mutable block* p; ///< Block, nullptr when empty. Mutable as
+                      ///< share_prefix() may move the bytes into shared
+                      ///< storage, which leaves the value unchanged
+};
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Ordered map from strings, keyed by compact_string
+/// @ingroup MySTL
+/// @tparam Value Value type
+/// @tparam SmallSize As for mystl::map
+/// @tparam Indexed As for mystl::map, hashing needs \c std::hash of the key
+/// @tparam Balance As for mystl::map
+///
+/// Keys convert implicitly from \c std::string and string literals, and
+/// iteration yields them in the same order as a \c std::string key would.
+////////////////////////////////////////////////////////////////////////////////
+template<typename Value, size_t SmallSize = 0, bool Indexed = false,
+  typename Balance = avl_policy>
+  using string_map = map<compact_string, Value, SmallSize, Indexed, Balance>;
+
+}
+
+namespace std {
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief FNV-1a hash of a compact_string, for indexed string maps
+////////////////////////////////////////////////////////////////////////////////
+template<>
+struct hash<mystl::compact_string> {
+  /// @param s String
+  /// @return Hash
+  size_t operator()(const mystl::compact_string& s) const {
+    return s.hash();
+  }
+};
+
+}
+
+#endif
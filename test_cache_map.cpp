@@ -0,0 +1,265 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <list>
+#include <map>
+#include <string>
+
+#include "cache_map.h"
+
+#include "unit_test.h"
+
+using std::string;
+using std::make_pair;
+using std::chrono::milliseconds;
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Clock advanced by hand, in milliseconds
+////////////////////////////////////////////////////////////////////////////////
+struct test_clock {
+  typedef milliseconds duration;               ///< Duration type
+  typedef duration::rep rep;                   ///< Tick count type
+  typedef duration::period period;             ///< Tick period
+  typedef std::chrono::time_point<test_clock> time_point; ///< Time type
+  static constexpr bool is_steady = true;      ///< Never goes back
+
+  /// @return Current time
+  static time_point now() {return time_point(duration(ms));}
+
+  static long long ms; ///< Milliseconds since the epoch
+};
+
+long long test_clock::ms = 0;
+
+typedef mystl::cache_map<int, string, test_clock> cache;
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Testing of cache_map
+/// @ingroup Testing
+////////////////////////////////////////////////////////////////////////////////
+class cache_map_test : public test_class {
+
+  protected:
+
+    void test() {
+      test_capacity();
+
+      test_recency();
+
+      test_ttl();
+
+      test_per_entry_ttl();
+
+      test_long_ttl();
+
+      test_erase();
+
+      test_random_against_model();
+
+      test_copy();
+    }
+
+  private:
+
+    /// @brief Setup cache of integers to strings, 1 most recently used
+    void setup_dummy_cache(cache& m) {
+      m[5] = "o";
+      m[4] = "l";
+      m[3] = "l";
+      m[2] = "e";
+      m[1] = "H";
+    }
+
+    /// @brief Test that inserts beyond the capacity evict the oldest entries
+    void test_capacity() {
+      cache m(3);
+      setup_dummy_cache(m);
+
+      assert_msg(m.size() == 3 && m.count(5) == 0 && m.count(4) == 0 &&
+          m.count(3) == 1 && m.capacity() == 3 && m.balanced(),
+          "Cache capacity failed.");
+    }
+
+    /// @brief Test that find, operator[] and at mark entries as recently used
+    void test_recency() {
+      cache m(5);
+      setup_dummy_cache(m);
+      m.find(5);
+      m[4];
+      m.at(3);
+      m.insert(make_pair(6, "!"));
+      m[7] = "?";
+
+      assert_msg(m.size() == 5 && m.count(2) == 0 && m.count(1) == 0 &&
+          m.count(5) == 1 && m.count(4) == 1 && m.count(3) == 1,
+          "Cache recency failed.");
+    }
+
+    /// @brief Test entries expire after the default lifetime
+    void test_ttl() {
+      test_clock::ms = 0;
+      cache m(0, milliseconds(10));
+      setup_dummy_cache(m);
+      test_clock::ms = 10;
+      bool alive = m.count(1) == 1 && m.expire() == 0 && m.size() == 5;
+      test_clock::ms = 11;
+      bool due = m.count(1) == 0 && m.size() == 5;
+
+      assert_msg(alive && due && m.expire() == 5 && m.empty(),
+          "Cache ttl failed.");
+    }
+
+    /// @brief Test lifetimes given per entry and restarted by insert
+    void test_per_entry_ttl() {
+      test_clock::ms = 0;
+      cache m(0, milliseconds(5));
+      m[1] = "a";
+      m.insert(make_pair(2, "b"), milliseconds(100));
+      m.insert(make_pair(3, "c"), milliseconds(0));
+      test_clock::ms = 4;
+      m.insert(make_pair(1, "A"));
+      test_clock::ms = 9;
+      m.find(2);
+      bool one = m.size() == 3 && m.at(1) == "A";
+      test_clock::ms = 10;
+      m.find(2);
+
+      assert_msg(one && m.size() == 2 && m.count(1) == 0 && m.count(3) == 1,
+          "Cache per entry ttl failed.");
+    }
+
+    /// @brief Test lifetimes cascading through every level and beyond the top
+    void test_long_ttl() {
+      test_clock::ms = 0;
+      cache m(0);
+      long long ttl[] = {70, 5000, 300000, 20000000, 40000000};
+      for(int i = 0; i < 5; ++i)
+        m.insert(make_pair(i, "x"), milliseconds(ttl[i]));
+      bool ok = true;
+      for(int i = 0; i < 5; ++i) {
+        test_clock::ms = ttl[i];
+        ok = ok && m.expire() == 0 && m.size() == size_t(5 - i);
+        test_clock::ms = ttl[i] + 1;
+        ok = ok && m.expire() == 1 && m.count(i) == 0;
+      }
+      assert_msg(ok && m.empty(), "Cache long ttl failed.");
+    }
+
+    /// @brief Test erase by key and iterator
+    void test_erase() {
+      test_clock::ms = 0;
+      cache m(0, milliseconds(10));
+      setup_dummy_cache(m);
+      size_t i = m.erase(3);
+      size_t j = m.erase(3);
+      cache::iterator k = m.erase(m.begin());
+      test_clock::ms = 20;
+
+      assert_msg(i == 1 && j == 0 && k->first == 2 && m.size() == 3 &&
+          m.expire() == 3, "Cache erase failed.");
+    }
+
+    /// @brief Test random operations and clock advances against a model
+    void test_random_against_model() {
+      test_clock::ms = 0;
+      const size_t cap = 200;
+      cache m(cap, milliseconds(50));
+      std::map<int, std::pair<string, long long>> s; // value, expiry or 0
+      std::list<int> order;                          // most recent first
+      auto use = [&](int k) {order.remove(k); order.push_front(k);};
+      auto expire = [&]() {
+        for(auto i = s.begin(); i != s.end();)
+          if(i->second.second && i->second.second <= test_clock::ms) {
+            order.remove(i->first);
+            i = s.erase(i);
+          }
+          else ++i;
+      };
+      auto put = [&](int k, const string& v, long long ttl) {
+        s[k] = make_pair(v, ttl ? test_clock::ms + ttl + 1 : 0);
+        use(k);
+        if(s.size() > cap) {
+          s.erase(order.back());
+          order.pop_back();
+        }
+      };
+
+      srand(17);
+      bool ok = true;
+      for(int i = 0; i < 30000 && ok; ++i) {
+        int r = rand() % 100;
+        test_clock::ms += r < 60 ? 0 : r < 95 ? rand() % 4 :
+          r < 99 ? rand() % 5000 : rand() % 20000000;
+        int k = rand() % 400;
+        string v = std::to_string(i);
+        switch(rand() % 5) {
+          case 0: {
+            long long ttl = rand() % 3 ? rand() % 100 : rand() % 100000;
+            m.insert(make_pair(k, v), milliseconds(ttl));
+            expire();
+            put(k, v, ttl);
+            break;
+          }
+          case 1:
+            m[k] = v;
+            expire();
+            if(s.count(k)) {
+              s[k].first = v;
+              use(k);
+            }
+            else put(k, v, 50);
+            break;
+          case 2: {
+            cache::iterator j = m.find(k);
+            expire();
+            ok = (j == m.end()) == (s.count(k) == 0) &&
+              (j == m.end() || j->second == s[k].first);
+            if(s.count(k)) use(k);
+            break;
+          }
+          case 3:
+            ok = m.erase(k) == (expire(), s.erase(k));
+            order.remove(k);
+            break;
+          default:
+            ok = m.count(k) == (s.count(k) &&
+                !(s[k].second && s[k].second <= test_clock::ms));
+        }
+        ok = ok && m.size() == s.size();
+      }
+      auto j = s.begin();
+      for(auto&& x : m)
+        ok = ok && j != s.end() && x.first == (j++)->first;
+      assert_msg(ok && m.balanced(), "Cache random operations failed.");
+    }
+
+    /// @brief Test copies keep recency order and lifetimes
+    void test_copy() {
+      test_clock::ms = 0;
+      cache m1(5, milliseconds(10));
+      setup_dummy_cache(m1);
+      m1.find(5);
+      cache m2(m1);
+      cache m3(1);
+      m3[9] = "*";
+      m3 = m1;
+      m2[6] = "!";
+      m3[7] = "?";
+      m3[8] = "?";
+      bool ok = m1.size() == 5 && m2.count(4) == 0 && m2.count(5) == 1 &&
+        m3.count(3) == 0 && m3.count(5) == 1;
+      test_clock::ms = 20;
+
+      assert_msg(ok && m2.expire() == 5 && m3.expire() == 5 &&
+          m1.expire() == 5, "Cache copy failed.");
+    }
+};
+
+int main() {
+  cache_map_test lt;
+
+  if(lt.run())
+    std::cout << "All tests passed." << std::endl;
+
+  return 0;
+}
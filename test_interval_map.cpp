@@ -0,0 +1,173 @@
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "interval_map.h"
+
+#include "unit_test.h"
+
+using std::string;
+using std::pair;
+using mystl::interval_map;
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Testing of interval_map
+/// @ingroup Testing
+////////////////////////////////////////////////////////////////////////////////
+class interval_map_test : public test_class {
+
+  protected:
+
+    void test() {
+      test_insert();
+
+      test_overlapping();
+
+      test_stabbing();
+
+      test_replace_end();
+
+      test_erase();
+
+      test_random_against_brute_force();
+
+      test_copy();
+    }
+
+  private:
+
+    typedef interval_map<int, string> imap;
+
+    /// @brief Setup map of intervals to names
+    void setup_dummy_map(imap& m) {
+      m.insert(1, 3, "a");
+      m.insert(2, 10, "b");
+      m.insert(4, 5, "c");
+      m.insert(6, 6, "d");
+      m.insert(8, 9, "e");
+    }
+
+    /// @param m Map
+    /// @param lo Start of range
+    /// @param hi End of range
+    /// @return Values of the intervals overlapping [lo, hi]
+    static string overlap(const imap& m, int lo, int hi) {
+      std::vector<imap::const_iterator> r;
+      m.overlapping(lo, hi, std::back_inserter(r));
+      string s;
+      for(auto&& i : r)
+        s += i->second.second;
+      return s;
+    }
+
+    /// @brief Test insertion of new and existing starts
+    void test_insert() {
+      imap m;
+      setup_dummy_map(m);
+      pair<imap::iterator, bool> i = m.insert(4, 7, "C");
+
+      assert_msg(m.size() == 5 && !i.second && i.first->first == 4 &&
+          i.first->second.first == 7 && m.find(4)->second.second == "C" &&
+          m.balanced(), "Interval insert failed.");
+    }
+
+    /// @brief Test overlap queries, with closed end points
+    void test_overlapping() {
+      imap m;
+      setup_dummy_map(m);
+
+      assert_msg(overlap(m, 3, 4) == "abc" && overlap(m, 11, 20) == "" &&
+          overlap(m, -5, 0) == "" && overlap(m, 10, 10) == "b" &&
+          overlap(m, 0, 100) == "abcde" && overlap(m, 7, 7) == "b",
+          "Interval overlapping failed.");
+    }
+
+    /// @brief Test point queries
+    void test_stabbing() {
+      imap m;
+      setup_dummy_map(m);
+      std::vector<imap::iterator> r;
+      m.stabbing(6, std::back_inserter(r));
+
+      assert_msg(r.size() == 2 && r[0]->first == 2 && r[1]->first == 6,
+          "Interval stabbing failed.");
+    }
+
+    /// @brief Test that shrinking an end through insert updates the queries
+    void test_replace_end() {
+      imap m;
+      setup_dummy_map(m);
+      m.insert(2, 2, "b");
+
+      assert_msg(overlap(m, 7, 7) == "" && overlap(m, 9, 12) == "e",
+          "Interval replace end failed.");
+    }
+
+    /// @brief Test erase by key and iterator
+    void test_erase() {
+      imap m;
+      setup_dummy_map(m);
+      m.erase(2);
+      m.erase(m.find(8));
+
+      assert_msg(m.size() == 3 && overlap(m, 0, 100) == "acd" &&
+          overlap(m, 7, 10) == "", "Interval erase failed.");
+    }
+
+    /// @brief Test random operations against a scan of std::map
+    void test_random_against_brute_force() {
+      interval_map<int, int> m;
+      std::map<int, pair<int, int>> s;
+      srand(11);
+      bool ok = true;
+      for(int i = 0; i < 20000 && ok; ++i) {
+        int lo = rand() % 5000;
+        int len = rand() % 8 ? rand() % 20 : rand() % 1000;
+        switch(rand() % 4) {
+          case 0:
+          case 1: m.insert(lo, lo + len, i); s[lo] = std::make_pair(lo + len, i);
+                  break;
+          case 2: ok = m.erase(lo) == s.erase(lo); break;
+          default: {
+            std::vector<interval_map<int, int>::iterator> r;
+            m.overlapping(lo, lo + len, std::back_inserter(r));
+            size_t j = 0;
+            for(auto&& x : s)
+              if(x.first <= lo + len && lo <= x.second.first)
+                ok = ok && j < r.size() && r[j++]->first == x.first;
+            ok = ok && j == r.size();
+          }
+        }
+        if(i % 512 == 0)
+          ok = ok && m.valid();
+      }
+      assert_msg(ok && m.size() == s.size() && m.balanced() && m.valid(),
+          "Interval random operations failed.");
+    }
+
+    /// @brief Test copies keep the cached ends
+    void test_copy() {
+      imap m1;
+      setup_dummy_map(m1);
+      imap m2(m1);
+      imap m3;
+      m3.insert(0, 0, "z");
+      m3 = m1;
+      m2.erase(2);
+
+      assert_msg(overlap(m1, 7, 7) == "b" && overlap(m2, 7, 7) == "" &&
+          overlap(m3, 3, 4) == "abc", "Interval copy failed.");
+    }
+};
+
+int main() {
+  interval_map_test lt;
+
+  if(lt.run())
+    std::cout << "All tests passed." << std::endl;
+
+  return 0;
+}
@@ -1,9 +1,16 @@
 #include <algorithm>
+#include <iterator>
+#include <map>
+#include <cmath>
+#include <cstdlib>
+#include <numeric>
 #include <string>
+#include <vector>
 #include <iostream>
 
 #include "map.h"
 
+#include "map_test_helpers.h"
 #include "unit_test.h"
 
 using std::all_of;
@@ -35,6 +42,10 @@ class map_test : public test_class {
 
       test_find_not_exists();
 
+      test_find_many();
+
+      test_find_sorted();
+
       test_count_exists();
 
       test_count_not_exists();
@@ -50,6 +61,32 @@ class map_test : public test_class {
       test_copy_constructor();
 
       test_copy_assign();
+
+      test_height();
+
+      test_memory_usage();
+
+      test_small_map();
+
+      test_extract_insert();
+
+      test_merge();
+
+      test_large_copy();
+
+      test_bulk_load();
+
+      test_compact();
+
+      test_hash_index();
+
+      test_finger_search();
+
+      test_balancing_policies();
+
+      test_lazy_erase();
+
+      test_out_of_line();
     }
 
   private:
@@ -113,7 +150,7 @@ std::cout<<"Insert 7.\n";
         string val = m.at(7);
         assert_msg(false, "Element access at not exists failed");
       }
-      catch(std::out_of_range) {
+      catch(const std::out_of_range&) {
         //test success!
       }
       catch(...) {
@@ -141,6 +178,57 @@ std::cout<<"Insert 7.\n";
       assert_msg(i == m.end(), "Find exists failed.");
     }
 
+    /// @brief Test batched find over more keys than one interleaved group
+    void test_find_many() {
+      map<int, int> m;
+      for(int i = 0; i < 100; i += 2)
+        m[i] = -i;
+
+      std::vector<int> keys;
+      for(int i = 99; i >= 0; --i)
+        keys.push_back(i);
+      std::vector<map<int, int>::iterator> res;
+      m.find_many(keys.begin(), keys.end(), std::back_inserter(res));
+
+      bool ok = res.size() == keys.size();
+      for(size_t i = 0; ok && i < keys.size(); ++i)
+        ok = keys[i] % 2 ? res[i] == m.end() :
+          res[i]->first == keys[i] && res[i]->second == -keys[i];
+      assert_msg(ok, "Find many failed.");
+    }
+
+    /// @brief Test merged traversal with unsorted and duplicate keys
+    void test_find_sorted() {
+      map<int, int> m;
+      for(int i = 0; i < 100; i += 2)
+        m[i] = -i;
+
+      std::vector<int> keys;
+      for(int i = 0; i < 120; ++i)
+        keys.push_back((i * 37) % 110 - 5);
+      std::vector<map<int, int>::const_iterator> res;
+      const map<int, int>& cm = m;
+      cm.find_sorted(keys.begin(), keys.end(), std::back_inserter(res));
+
+      bool ok = res.size() == keys.size();
+      for(size_t i = 0; ok && i < keys.size(); ++i)
+        ok = keys[i] < 0 || keys[i] >= 100 || keys[i] % 2 ?
+          res[i] == cm.cend() : res[i]->first == keys[i];
+
+      // sorted inserts leave a splay tree as a path of every key
+      map<int, int, 0, false, mystl::splay_policy> p;
+      for(int i = 0; i < 1 << 21; ++i)
+        p[i] = i;
+      const map<int, int, 0, false, mystl::splay_policy> cp(p);
+      int few[] = {2, 0, 1, -1};
+      std::vector<map<int, int, 0, false, mystl::splay_policy>::const_iterator>
+        pres;
+      cp.find_sorted(few, few + 4, std::back_inserter(pres));
+      ok = ok && cp.height() == 1 << 21 && pres[0]->first == 2 &&
+        pres[1]->first == 0 && pres[2]->first == 1 && pres[3] == cp.cend();
+      assert_msg(ok, "Find sorted failed.");
+    }
+
     /// @brief Test count when element exists
     void test_count_exists() {
       map<int, string> m;
@@ -208,7 +296,6 @@ std::cout<<"Insert 7.\n";
       setup_dummy_map(m);
 
       size_t i = m.erase(5);
-      map<int, string>::iterator j = m.find(3);
       assert_msg(i == 1 && m.size() == 4, "Erase key failed.");
 
       if(m.balanced()) std::cout<<"Tree is balanced.\n";
@@ -262,6 +349,477 @@ std::cout<<"Insert 7.\n";
             ),
           "Copy assign failed.");
     }
+
+    /// @brief Test height and depth histogram stay within the AVL bound
+    void test_height() {
+      map<int, int> m;
+      assert_msg(m.height() == 0 && m.depth_histogram().empty(),
+          "Height of empty map failed.");
+
+      for(int i = 0; i < 1000; ++i)
+        m[i] = i;
+      m.insert(make_pair(1000, 1000));
+
+      std::vector<size_t> h = m.depth_histogram();
+      assert_msg(h.size() == m.height() &&
+          std::accumulate(h.begin(), h.end(), size_t(0)) == m.size() &&
+          m.height() <= 1.44 * std::log2(m.size() + 2),
+          "Height failed.");
+    }
+
+    /// @brief Test memory usage accounts for every node
+    void test_memory_usage() {
+      map<int, string> m;
+      setup_dummy_map(m);
+
+      map<int, string>::memory_stats s = m.memory_usage();
+      bool ok = s.internal_count == 5 && s.external_count == 8 &&
+        s.payload == 5 * sizeof(map<int, string>::value_type) &&
+        s.total() > s.payload + s.internal_nodes + s.external_nodes;
+
+      // a copy keeps its slabs while any node in them lives
+      map<int, int> b;
+      for(int i = 0; i < 100000; ++i)
+        b[i] = i;
+      map<int, int> c(b);
+      size_t full = c.memory_usage().total();
+      for(int i = 0; i < 100000; ++i)
+        if(i % 100) c.erase(i);
+      map<int, int>::memory_stats e = c.memory_usage();
+      ok = ok && e.internal_count == 1000 && e.total() > full * 9 / 10 &&
+        e.allocator_overhead > e.total() * 9 / 10;
+
+      // churn reuses the freed slots rather than growing
+      map<int, int> d(b);
+      for(int i = 0; i < 100000; ++i) {
+        d.erase(i);
+        d[-1 - i] = i;
+      }
+      ok = ok && d.memory_usage().total() < full * 21 / 20;
+
+      c.compact();
+      ok = ok && c.memory_usage().total() < e.total() / 20 && c.size() == 1000;
+      assert_msg(ok, "Memory usage failed.");
+    }
+
+    /// @brief Test small-size mode below, at and beyond its inline capacity
+    void test_small_map() {
+      typedef map<int, string, 4> small_map;
+      small_map m;
+      m[3] = "l";
+      m[1] = "H";
+      m.insert(make_pair(2, "e"));
+      m[4] = "l";
+
+      bool ok = m.size() == 4 && m.height() == 0 && m.count(3) == 1 &&
+        m.count(5) == 0 && m.find(1)->second == "H" && m.rbegin()->first == 4 &&
+        m.memory_usage().external_count == 0;
+
+      small_map c(m);
+      ok = ok && m.erase(1) == 1 && m.erase(7) == 0 && m.begin()->first == 2 &&
+        m.erase(m.find(3))->first == 4 && m.size() == 2;
+
+      c[0] = "-";
+      c[5] = "o";
+      int k = 0;
+      for(auto&& x : c)
+        ok = ok && x.first == k++;
+      ok = ok && c.size() == 6 && c.height() > 0 && c.balanced() &&
+        (--c.end())->first == 5;
+
+      small_map d;
+      d = c;
+      c.clear();
+      c[9] = "!";
+      ok = ok && d.size() == 6 && d.at(5) == "o" && c.size() == 1 &&
+        c.height() == 0 && c.begin()->second == "!";
+      assert_msg(ok, "Small map failed.");
+    }
+
+    /// @brief Test moving entries between maps through node handles
+    void test_extract_insert() {
+      map<int, string> m1, m2;
+      for(int i = 0; i < 32; ++i)
+        m1[i] = "v";
+      m2[8] = "x";
+
+      map<int, string>::iterator nine = m1.find(9);
+      map<int, string>::node_type h = m1.extract(8);
+      const string* addr = &h.mapped();
+      bool ok = !h.empty() && h.key() == 8 && m1.size() == 31 &&
+        m1.count(8) == 0 && nine->first == 9 && m1.balanced() &&
+        m1.extract(100).empty();
+
+      map<int, string>::insert_return_type r = m2.insert(std::move(h));
+      ok = ok && !r.inserted && !r.node.empty() && r.position->second == "x";
+
+      r.node.key() = 40;
+      map<int, string>::insert_return_type s = m2.insert(std::move(r.node));
+      ok = ok && s.inserted && s.node.empty() && &s.position->second == addr &&
+        m2.size() == 2 && m2.find(40) == s.position;
+
+      for(int i = 0; i < 31; ++i)
+        m2.insert(m1.extract(m1.begin()));
+      ok = ok && m1.empty() && m2.size() == 33 && m2.balanced();
+      assert_msg(ok, "Extract and insert failed.");
+    }
+
+    /// @brief Test merge keeps colliding keys in the source
+    void test_merge() {
+      map<int, int> m1, m2;
+      for(int i = 0; i < 100; i += 2)
+        m1[i] = 1;
+      for(int i = 0; i < 100; i += 3)
+        m2[i] = 2;
+
+      m1.merge(m2);
+
+      bool ok = m1.size() == 67 && m2.size() == 17 && m1.balanced();
+      for(auto&& x : m2)
+        ok = ok && x.first % 6 == 0 && m1[x.first] == 1;
+
+      map<int, int, 8> s1, s2;
+      s1[1] = 1;
+      s2[1] = 2;
+      s2[2] = 2;
+      s1.merge(s2);
+      ok = ok && s1.size() == 2 && s2.size() == 1 && s1[2] == 2;
+      assert_msg(ok, "Merge failed.");
+    }
+
+    /// @brief Test copy and teardown of a tree large enough to use threads,
+    ///        and that copies are laid out in inorder
+    void test_large_copy() {
+      map<int, int> m1;
+      for(int i = 0; i < (1 << 17); ++i)
+        m1[(i * 7919) % (1 << 17)] = i;
+
+      map<int, int> m2(m1);
+      map<int, int> m3;
+      m3[1] = 1;
+      m3 = m2;
+      m2.clear();
+
+      bool ok = m2.empty() && m3.size() == m1.size() && m3.balanced() &&
+        m3.height() == m1.height() &&
+        std::equal(m1.begin(), m1.end(), m3.begin());
+
+      size_t ascending = 0;
+      const int* prev = nullptr;
+      for(auto&& x : m3) {
+        if(&x.second > prev) ++ascending;
+        prev = &x.second;
+      }
+      ok = ok && ascending > m3.size() * 99 / 100;
+
+      for(int i = 0; i < 1000; ++i)
+        m3.erase(i);
+      m3[-1] = 0;
+      ok = ok && m3.size() == m1.size() - 999 && m3.balanced();
+      assert_msg(ok, "Large copy failed.");
+    }
+
+    /// @brief Test bulk mode with a sorted load, lookups and erases inside
+    ///        the scope, and the balanced rebuild on exit
+    void test_bulk_load() {
+      map<int, int> m;
+      bool ok = true;
+      {
+        map<int, int>::bulk_load_scope scope(m);
+        for(int i = 0; i < 10000; ++i) {
+          m[i] = i;
+          if(i % 1000 == 999)
+            ok = ok && m.find(i / 2)->second == i / 2 && m.count(i + 1) == 0;
+        }
+        for(int i = 0; i < 10000; i += 10)
+          m.erase(i);
+        m.insert(make_pair(-1, -1));
+        ok = ok && m.in_bulk() && m.size() == 9001 &&
+          m.depth_histogram().size() <= 2 + std::log(9001.0) / std::log(1.5);
+      }
+
+      map<int, int> c(m);
+      int prev = -2;
+      for(auto&& x : m) {
+        ok = ok && prev < x.first;
+        prev = x.first;
+      }
+      ok = ok && !m.in_bulk() && m.balanced() &&
+        m.height() == m.depth_histogram().size() &&
+        m.height() <= std::ceil(std::log2(m.size() + 1)) &&
+        c.size() == m.size();
+
+      m[20000] = 0;
+      m.erase(5);
+      ok = ok && m.height() <= 1.44 * std::log2(m.size() + 2);
+      assert_msg(ok, "Bulk load failed.");
+    }
+
+    /// @brief Test compaction after churn keeps the entries and lays the
+    ///        nodes out in inorder
+    void test_compact() {
+      map<int, string> m;
+      for(int i = 0; i < 20000; ++i) {
+        m[(i * 7919) % 20000] = std::to_string(i);
+        if(i % 3 == 0) m.erase((i * 104729) % 20000);
+      }
+      map<int, string> c(m);
+
+      m.compact();
+
+      size_t ascending = 0;
+      const string* prev = nullptr;
+      for(auto&& x : m) {
+        if(&x.second > prev) ++ascending;
+        prev = &x.second;
+      }
+      bool ok = m.size() == c.size() && m.balanced() &&
+        std::equal(c.begin(), c.end(), m.begin()) &&
+        ascending > m.size() * 99 / 100;
+
+      m[-1] = "x";
+      m.erase(c.begin()->first);
+      ok = ok && m.size() == c.size() && m.begin()->second == "x";
+      assert_msg(ok, "Compact failed.");
+    }
+
+    /// @brief Test the hashed side index stays in sync with the tree
+    void test_hash_index() {
+      map<int, int, 4, true> m;
+      std::map<int, int> s;
+      srand(11);
+      bool ok = true;
+      for(int i = 0; i < 50000 && ok; ++i) {
+        int k = rand() % 2000;
+        switch(rand() % 5) {
+          case 0: m[k] = i; s[k] = i; break;
+          case 1: m.insert(make_pair(k, i)); s[k] = i; break;
+          case 2: ok = m.erase(k) == s.erase(k); break;
+          case 3:
+            ok = m.count(k) == s.count(k) &&
+              (m.find(k) == m.end() || m.at(k) == s.at(k));
+            break;
+          default:
+            if(m.count(k)) m.erase(m.find(k));
+            s.erase(k);
+        }
+        if(i % 10000 == 9999) m.compact();
+      }
+      map<int, int, 4, true> c(m);
+      ok = ok && m.size() == s.size() && c.size() == s.size() &&
+        std::equal(s.begin(), s.end(), m.begin()) &&
+        m.memory_usage().index > 0;
+      for(auto&& x : s)
+        ok = ok && c.find(x.first)->second == x.second;
+
+      c.clear();
+      ok = ok && c.find(s.begin()->first) == c.end() && c.count(0) == 0;
+      assert_msg(ok, "Hash index failed.");
+    }
+
+    /// @brief Test lookups, inserts and erases around the last accessed key
+    void test_finger_search() {
+      map<int, int> m;
+      std::map<int, int> s;
+      for(int i = 0; i < 4096; i += 2)
+        m[i] = s[i] = i;
+
+      bool ok = true;
+      int k = 0;
+      for(int i = 0; i < 20000 && ok; ++i) {
+        k += rand() % 2 ? rand() % 7 - 3 : rand() % 101 - 50;
+        map<int, int>::iterator f = m.find(k);
+        ok = s.count(k) ? f != m.end() && f->second == s[k] : f == m.end();
+        ok = ok && m.count(k + 1) == s.count(k + 1);
+        ok = ok && m.erase(k - 2) == s.erase(k - 2);
+        m[k + 2] = s[k + 2] = i;
+      }
+      ok = ok && m.size() == s.size() && m.balanced() &&
+        std::equal(s.begin(), s.end(), m.begin());
+
+      // comparisons per lookup: a few for nearby keys, about twice the
+      // height (compare_keys takes two) for random ones
+      const int n = 1 << 16;
+      map<counted_key, int> c;
+      for(int i = 0; i < n; ++i)
+        c[counted_key{2 * i}] = i;
+      counted_key::compares() = 0;
+      for(int i = 0; i < n; ++i)
+        ok = ok && c.find(counted_key{2 * i}) != c.end();
+      size_t sequential = counted_key::compares();
+      counted_key::compares() = 0;
+      for(int i = 0, j = n; i < n; ++i) {
+        j += rand() % 7 - 3;
+        ok = ok && (c.find(counted_key{j}) != c.end()) == (j % 2 == 0);
+      }
+      size_t nearby = counted_key::compares();
+      counted_key::compares() = 0;
+      for(int i = 0; i < n; ++i)
+        c.find(counted_key{rand() % (2 * n)});
+      size_t random = counted_key::compares();
+      ok = ok && sequential <= 8 * size_t(n) && nearby <= 8 * size_t(n) &&
+        random >= 3 * nearby;
+      assert_msg(ok, "Finger search failed.");
+    }
+
+    /// @brief Test the WAVL, splay and treap balancing policies
+    void test_balancing_policies() {
+      bool ok = random_against_std_map<map<int, int, 0, false,
+          mystl::splay_policy>>(40000, 3000, 5) &&
+        random_against_std_map<map<int, int, 0, false,
+          mystl::treap_policy>>(40000, 3000, 5) &&
+        random_against_std_map<map<int, int, 0, false,
+          mystl::wavl_policy>>(40000, 3000, 5);
+
+      map<int, int, 0, false, mystl::wavl_policy> w;
+      for(int i = 0; i < 1 << 14; ++i)
+        w[i] = i;
+      ok = ok && w.height() == 15 && w.balanced();
+      for(int i = 0; i < 1 << 14; ++i)
+        if(i % 4) w.erase(i);
+      ok = ok && w.size() == 1 << 12 && w.height() <= 2 * 12 && w.balanced();
+
+      map<int, int, 0, false, mystl::treap_policy> t;
+      for(int i = 0; i < 1 << 14; ++i)
+        t[i] = i;
+      ok = ok && t.height() < 4 * 14;
+      {
+        map<int, int, 0, false, mystl::treap_policy>::bulk_load_scope b(t);
+        for(int i = 1 << 14; i < 1 << 15; ++i)
+          t[i] = i;
+      }
+      ok = ok && t.height() < 4 * 15 && t.balanced();
+
+      map<int, int, 0, false, mystl::splay_policy> s;
+      for(int i = 0; i < 1 << 10; ++i)
+        s[i] = i;
+      s.find(0);
+      ok = ok && s.depth_histogram().size() > 10 && s.begin()->first == 0;
+      assert_msg(ok, "Balancing policies failed.");
+    }
+
+    /// @brief Test lazy erase leaves tombstones that lookups and iterators
+    ///        skip, until they pass the policy's share and the tree is rebuilt
+    void test_lazy_erase() {
+      typedef map<int, int, 0, false, mystl::lazy_policy<>> lazy_map;
+      bool ok = random_against_std_map<map<int, int, 0, false,
+          mystl::lazy_policy<>>>(40000, 3000, 5) &&
+        random_against_std_map<map<int, int, 0, false,
+          mystl::lazy_policy<mystl::wavl_policy, 50>>>(40000, 3000, 5);
+
+      lazy_map m;
+      for(int i = 0; i < 100; ++i)
+        m[i] = i;
+      lazy_map::iterator keep = m.find(99);
+      for(int i = 0; i < 25; ++i)
+        m.erase(2 * i);
+      ok = ok && m.size() == 75 && m.memory_usage().internal_count == 100 &&
+        m.begin()->first == 1 && (++m.begin())->first == 3 &&
+        m.count(0) == 0 && m.find(48) == m.end() && m.erase(48) == 0;
+
+      m[0] = -1;
+      lazy_map::node_type h = m.extract(99);
+      lazy_map o;
+      o[99] = 7;
+      o.erase(99);
+      ok = ok && o.empty() && o.insert(std::move(h)).inserted &&
+        o.at(99) == 99 && o.size() == 1 && o.begin()->first == 99;
+      m[99] = 99;
+      keep = m.find(99);
+      lazy_map c(m);
+      ok = ok && m.size() == 76 && m.at(0) == -1 &&
+        m.memory_usage().internal_count == 100 && c.size() == 76 &&
+        std::equal(m.begin(), m.end(), c.begin()) &&
+        std::equal(m.rbegin(), m.rend(), c.rbegin());
+
+      lazy_map::iterator j = m.erase(m.find(1));
+      ok = ok && j->first == 3 && m.memory_usage().internal_count == 100;
+      m.erase(3);
+      ok = ok && m.size() == 74 && m.memory_usage().internal_count == 74 &&
+        keep->first == 99 && m.balanced() && m.height() == 7;
+
+      map<int, int, 0, true, mystl::lazy_policy<>> x;
+      std::map<int, int> s;
+      srand(3);
+      for(int i = 0; i < 20000 && ok; ++i) {
+        int k = rand() % 500;
+        if(rand() % 2) {
+          x[k] = s[k] = i;
+        }
+        else
+          ok = x.erase(k) == s.erase(k);
+        ok = ok && x.count(k) == s.count(k);
+      }
+      std::vector<int> keys;
+      std::vector<map<int, int, 0, true, mystl::lazy_policy<>>::iterator> r;
+      for(int k = 0; k < 500; ++k)
+        keys.push_back(k);
+      x.find_sorted(keys.begin(), keys.end(), std::back_inserter(r));
+      for(int k = 0; k < 500; ++k)
+        ok = ok && (r[k] == x.end()) == (s.count(k) == 0);
+      ok = ok && x.size() == s.size() &&
+        std::equal(s.begin(), s.end(), x.begin());
+      assert_msg(ok, "Lazy erase failed.");
+    }
+
+    /// @brief Test entries held out of line keep their address until erased
+    void test_out_of_line() {
+      typedef map<int, string, 0, false, mystl::avl_policy, true> boxed_map;
+      bool ok = random_against_std_map<map<int, int, 0, false,
+          mystl::avl_policy, true>>(40000, 3000, 5) &&
+        random_against_std_map<map<int, int, 0, false,
+          mystl::splay_policy, true>>(40000, 3000, 5) &&
+        random_against_std_map<map<int, int, 0, false,
+          mystl::lazy_policy<>, true>>(40000, 3000, 5);
+
+      boxed_map m;
+      std::map<int, const string*> at;
+      for(int i = 0; i < 2000; ++i) {
+        int k = (i * 7919) % 2000;
+        m[k] = std::to_string(k);
+        at[k] = &m.find(k)->second;
+      }
+      srand(9);
+      for(int i = 0; i < 1500; ++i) {
+        int k = rand() % 2000;
+        m.erase(k);
+        at.erase(k);
+      }
+      m[5000] = "x";
+      for(auto&& a : at)
+        ok = ok && &m.at(a.first) == a.second &&
+          *a.second == std::to_string(a.first);
+
+      boxed_map::node_type h = m.extract(m.begin());
+      h.key() = 4000;
+      ok = ok && m.insert(std::move(h)).inserted && m.at(4000).size() > 0 &&
+        (--m.end())->first == 5000 && m.size() == at.size() + 1 &&
+        m.balanced();
+      boxed_map c(m);
+      ok = ok && std::equal(m.begin(), m.end(), c.begin()) &&
+        &c.at(5000) != &m.at(5000);
+
+      map<int, string, 4, false, mystl::avl_policy, true> s;
+      for(int i = 4; i >= 0; --i) {
+        s[i] = std::to_string(i);
+        if(i == 2) s.erase(3);
+      }
+      ok = ok && s.size() == 4 && s.at(4) == "4" && s.begin()->second == "0";
+
+      struct big {
+        char b[512]; ///< Bulk of the value
+      };
+      map<int, big, 0, false, mystl::avl_policy, true> b;
+      for(int i = 0; i < 100; ++i)
+        b[i];
+      map<int, big>::memory_stats in = map<int, big>().memory_usage();
+      map<int, big, 0, false, mystl::avl_policy, true>::memory_stats out =
+        b.memory_usage();
+      ok = ok && in.external_nodes > 3 * sizeof(big) &&
+        out.external_nodes < 103 * 64 && out.internal_nodes < 100 * 64 &&
+        out.payload == 100 * sizeof(std::pair<const int, big>);
+      assert_msg(ok, "Out of line entries failed.");
+    }
 };
 
 int main() {
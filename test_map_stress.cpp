@@ -0,0 +1,177 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define MYSTL_COUNT_ROTATIONS
+#include "map.h"
+
+#include "map_test_helpers.h"
+#include "unit_test.h"
+
+using std::string;
+using std::make_pair;
+using mystl::map;
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Randomized stress and scaling tests of map
+/// @ingroup Testing
+///
+/// Every configuration of map runs a long random mix of operations next to
+/// std::map, with the whole tree checked by map::valid() along the way.
+/// Scaling tests bound the comparisons and rotations per operation as the map
+/// grows, so an operation that degrades past O(log n) fails here. Time is left
+/// to the timing benchmark, being too noisy to assert on.
+////////////////////////////////////////////////////////////////////////////////
+class map_stress_test : public test_class {
+
+  protected:
+
+    void test() {
+      test_count_external_leaf();
+
+      test_erase_missing();
+
+      test_random_avl();
+
+      test_random_configurations();
+
+      test_random_policies();
+
+      test_scaling();
+    }
+
+  private:
+
+    /// @brief Test lookups of keys that land on external leaves, whose keys
+    ///        are default constructed and never part of the map
+    template<typename M>
+    static bool missing_default_key() {
+      M m;
+      bool ok = m.count(0) == 0 && m.find(0) == m.end();
+      for(int i = 1; i <= 100; ++i)
+        m[i] = i;
+      ok = ok && m.count(0) == 0 && m.find(0) == m.end() &&
+        m.count(101) == 0 && m.erase(0) == 0;
+      for(int i = 1; i <= 100; ++i)
+        m.erase(i);
+      return ok && m.empty() && m.count(0) == 0 && m.count(50) == 0 &&
+        m.find(50) == m.end() && m.valid();
+    }
+
+    /// @brief Test count on keys that only external leaves hold
+    void test_count_external_leaf() {
+      bool ok = missing_default_key<map<int, int>>() &&
+        missing_default_key<map<int, int, 0, true>>() &&
+        missing_default_key<map<int, int, 8>>() &&
+        missing_default_key<map<int, int, 0, false, mystl::lazy_policy<>>>() &&
+        missing_default_key<map<int, int, 0, false, mystl::splay_policy>>() &&
+        missing_default_key<map<int, int, 0, false, mystl::avl_policy, true>>();
+      assert_msg(ok, "Count on external leaf failed.");
+    }
+
+    /// @brief Test erase of keys that are not in the map leaves it untouched
+    void test_erase_missing() {
+      map<int, int> m;
+      bool ok = m.erase(3) == 0 && m.empty() && m.valid();
+      for(int i = 0; i < 1000; i += 2)
+        m[i] = i;
+      for(int i = -1; i <= 1001; i += 2)
+        ok = ok && m.erase(i) == 0;
+      ok = ok && m.size() == 500 && m.valid() && m.erase(4) == 1 &&
+        m.erase(4) == 0 && m.size() == 499 && m.valid();
+
+      map<int, int, 0, false, mystl::lazy_policy<>> l;
+      for(int i = 0; i < 100; ++i)
+        l[i] = i;
+      ok = ok && l.erase(7) == 1 && l.erase(7) == 0 && l.size() == 99 &&
+        l.extract(7).empty() && l.valid();
+      assert_msg(ok, "Erase of missing keys failed.");
+    }
+
+    /// @brief Test millions of random operations on the default AVL map
+    void test_random_avl() {
+      bool ok = random_against_std_map<map<int, int>>(1000000, 4096, 1) &&
+        random_against_std_map<map<int, int>>(1000000, 1 << 20, 2) &&
+        random_against_std_map<map<int, int>>(200000, 16, 3);
+      assert_msg(ok, "Random AVL operations failed.");
+    }
+
+    /// @brief Test random operations on the other storage configurations
+    void test_random_configurations() {
+      bool ok =
+        random_against_std_map<map<int, int, 0, true>>(300000, 4096, 4) &&
+        random_against_std_map<map<int, int, 8>>(300000, 12, 5) &&
+        random_against_std_map<map<int, int, 8>>(300000, 4096, 6) &&
+        random_against_std_map<map<int, int, 0, false,
+          mystl::lazy_policy<>>>(300000, 4096, 7) &&
+        random_against_std_map<map<int, string, 0, false,
+          mystl::avl_policy, true>>(300000, 4096, 8) &&
+        random_against_std_map<map<int, string, 4, true,
+          mystl::lazy_policy<mystl::wavl_policy, 50>, true>>(300000, 4096, 9);
+      assert_msg(ok, "Random operations on configurations failed.");
+    }
+
+    /// @brief Test random operations under the other balancing policies
+    void test_random_policies() {
+      bool ok = random_against_std_map<map<int, int, 0, false,
+        mystl::wavl_policy>>(300000, 4096, 10) &&
+        random_against_std_map<map<int, int, 0, false,
+          mystl::splay_policy>>(300000, 4096, 11) &&
+        random_against_std_map<map<int, int, 0, false,
+          mystl::treap_policy>>(300000, 4096, 12);
+      assert_msg(ok, "Random operations on balancing policies failed.");
+    }
+
+    /// @brief Test comparisons and rotations per operation grow at most
+    ///        logarithmically with the size of the map
+    ///
+    /// Comparisons and rotations are exact, and bounded by the AVL height of
+    /// at most 1.44 log n.
+    void test_scaling() {
+      std::mt19937 rng(13);
+      bool ok = true;
+      for(size_t n = 1 << 10; n <= 1 << 19; n <<= 3) {
+        double lg = std::log2(double(n));
+        std::vector<counted_key> keys(n);
+        for(size_t i = 0; i < n; ++i)
+          keys[i].k = int(2 * i * 2654435761u);
+        std::shuffle(keys.begin(), keys.end(), rng);
+        map<counted_key, int> m;
+        mystl::rotation_count() = 0;
+        for(size_t i = 0; i < n; ++i)
+          m[keys[i]] = i;
+        ok = ok && mystl::rotation_count() <= n && m.valid() &&
+          m.height() <= 1.44 * lg + 2;
+
+        counted_key::compares() = 0;
+        size_t s = 0;
+        for(size_t i = 0; i < n; ++i)
+          s += m.count(keys[i]) + m.count(counted_key{keys[i].k + 1});
+        ok = ok && s == n &&
+          counted_key::compares() <= 2 * n * (2 * 1.44 * lg + 2);
+
+        mystl::rotation_count() = 0;
+        for(size_t i = 0; i < n; i += 2)
+          m.erase(keys[i]);
+        ok = ok && mystl::rotation_count() <= n && m.valid() &&
+          m.size() == n / 2;
+      }
+      assert_msg(ok, "Scaling of operations failed.");
+    }
+};
+
+int main() {
+  map_stress_test lt;
+
+  if(lt.run())
+    std::cout << "All tests passed." << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,212 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+
+#include "radix_map.h"
+
+#include "unit_test.h"
+
+using std::string;
+using std::pair;
+using std::make_pair;
+using mystl::radix_map;
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Testing of radix_map
+/// @ingroup Testing
+////////////////////////////////////////////////////////////////////////////////
+class radix_map_test : public test_class {
+
+  protected:
+
+    void test() {
+      test_default_constructor();
+
+      test_element_access();
+
+      test_find();
+
+      test_insert();
+
+      test_signed_order();
+
+      test_erase_iterator();
+
+      test_erase_key();
+
+      test_node_growth();
+
+      test_random_against_std_map();
+
+      test_copy();
+    }
+
+  private:
+
+    /// @brief Setup map of integers to strings
+    void setup_dummy_map(radix_map<int, string>& m) {
+      m[3] = "l";
+      m[1] = "H";
+      m[2] = "e";
+      m[5] = "o";
+      m[4] = "l";
+    }
+
+    /// @brief Test default constructor generates map of size 0
+    void test_default_constructor() {
+      radix_map<int, string> m;
+
+      assert_msg(m.size() == 0 && m.empty() && m.begin() == m.end(),
+          "Radix default construction failed.");
+    }
+
+    /// @brief Test element access operator and at
+    void test_element_access() {
+      radix_map<int, string> m;
+      setup_dummy_map(m);
+
+      assert_msg(m[5] == "o" && m.at(1) == "H" && m[7] == "" && m.size() == 6,
+          "Radix element access failed.");
+
+      try {
+        m.at(8);
+        assert_msg(false, "Radix element access at not exists failed");
+      }
+      catch(const std::out_of_range&) {
+        //test success!
+      }
+    }
+
+    /// @brief Test find and count
+    void test_find() {
+      radix_map<int, string> m;
+      setup_dummy_map(m);
+
+      radix_map<int, string>::iterator i = m.find(5);
+
+      assert_msg(i->first == 5 && i->second == "o" && m.find(7) == m.end() &&
+          m.count(2) == 1 && m.count(-2) == 0,
+          "Radix find failed.");
+    }
+
+    /// @brief Test insertion of existing and new elements
+    void test_insert() {
+      radix_map<int, string> m;
+      setup_dummy_map(m);
+
+      pair<radix_map<int, string>::iterator, bool> i = m.insert(make_pair(5, "O"));
+      pair<radix_map<int, string>::iterator, bool> j = m.insert(make_pair(7, "!"));
+
+      assert_msg(!i.second && i.first->second == "O" &&
+          j.second && j.first->first == 7 && m.size() == 6,
+          "Radix insert failed.");
+    }
+
+    /// @brief Test iteration order of negative and positive keys
+    void test_signed_order() {
+      radix_map<int, int> m;
+      int keys[] = {5, -1, 0, -300, 70000, -70000, 1 << 30, -(1 << 30)};
+      for(int k : keys)
+        m[k] = k;
+
+      bool ok = std::is_sorted(m.begin(), m.end(),
+          [](const pair<const int, int>& a, const pair<const int, int>& b) {
+          return a.first < b.first;});
+      ok = ok && m.rbegin()->first == 1 << 30 && m.begin()->first == -(1 << 30);
+      assert_msg(ok && m.size() == 8, "Radix signed order failed.");
+    }
+
+    /// @brief Test erase with an iterator
+    void test_erase_iterator() {
+      radix_map<int, string> m;
+      setup_dummy_map(m);
+      radix_map<int, string>::iterator j = ++m.begin();
+
+      radix_map<int, string>::iterator i = m.erase(m.begin());
+
+      assert_msg(i == j && m.size() == 4, "Radix erase iterator failed.");
+    }
+
+    /// @brief Test erase with present and missing keys
+    void test_erase_key() {
+      radix_map<int, string> m;
+      setup_dummy_map(m);
+
+      size_t i = m.erase(5);
+      size_t j = m.erase(5);
+
+      assert_msg(i == 1 && j == 0 && m.size() == 4 && m.find(5) == m.end() &&
+          m.find(4) != m.end(), "Radix erase key failed.");
+    }
+
+    /// @brief Test growing through every node size and shrinking back
+    void test_node_growth() {
+      radix_map<uint64_t, int> m;
+      for(uint64_t i = 0; i < 256; ++i)
+        m[i << 8] = int(i);
+
+      bool ok = m.size() == 256;
+      int expect = 0;
+      for(auto&& x : m)
+        ok = ok && x.second == expect++;
+
+      for(uint64_t i = 0; i < 256; i += 2)
+        m.erase(i << 8);
+      for(uint64_t i = 0; i < 256; ++i)
+        ok = ok && m.count(i << 8) == i % 2;
+
+      for(uint64_t i = 1; i < 256; i += 2)
+        m.erase(i << 8);
+      assert_msg(ok && m.empty() && m.begin() == m.end(),
+          "Radix node growth failed.");
+    }
+
+    /// @brief Test random operations against std::map
+    void test_random_against_std_map() {
+      radix_map<int, int> m;
+      std::map<int, int> s;
+      srand(7);
+      bool ok = true;
+      for(int i = 0; i < 200000 && ok; ++i) {
+        int k = rand() % 5000 - 2500;
+        if(i & 1) k *= 65537;
+        switch(rand() % 3) {
+          case 0: m[k] = i; s[k] = i; break;
+          case 1: ok = m.erase(k) == s.erase(k); break;
+          default: ok = m.count(k) == s.count(k);
+        }
+      }
+      ok = ok && m.size() == s.size() &&
+        std::equal(s.begin(), s.end(), m.cbegin());
+      assert_msg(ok, "Radix random operations failed.");
+    }
+
+    /// @brief Test copy construction and assignment are deep
+    void test_copy() {
+      radix_map<int, string> m1;
+      setup_dummy_map(m1);
+      radix_map<int, string> m2(m1);
+      radix_map<int, string> m3;
+      m3[9] = "*";
+      m3 = m1;
+
+      for(auto&& x : m2)
+        x.second = "w";
+      m3.erase(1);
+
+      assert_msg(m2.size() == 5 && m1[1] == "H" && m2[1] == "w" &&
+          m3.size() == 4 && m1.size() == 5, "Radix copy failed.");
+    }
+};
+
+int main() {
+  radix_map_test lt;
+
+  if(lt.run())
+    std::cout << "All tests passed." << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,152 @@
+#include <iostream>
+#include <map>
+#include <string>
+
+#include "static_map.h"
+
+#include "unit_test.h"
+
+using std::string;
+using mystl::static_map;
+using mystl::literal_string;
+using mystl::make_static_map;
+
+/// @brief Opcode names, built and sorted by the compiler
+constexpr static_map<int, const char*, 6> opcodes({
+    {0x90, "nop"}, {0x01, "add"}, {0xc3, "ret"}, {0x29, "sub"},
+    {0xe8, "call"}, {0x0f, "esc"}});
+
+/// @brief Configuration keys, built and sorted by the compiler
+constexpr auto config = make_static_map<literal_string, int>({
+    {"timeout", 30}, {"retries", 3}, {"port", 8080}, {"host", 1},
+    {"hostname", 2}, {"", 0}, {"port_alt", 8081}});
+
+static_assert(opcodes.size() == 6 && opcodes.begin()->first == 0x01 &&
+    (opcodes.end() - 1)->first == 0xe8, "static_map not sorted");
+static_assert(opcodes.count(0xc3) == 1 && opcodes.count(0xc4) == 0 &&
+    opcodes.find(0x02) == opcodes.end(), "static_map lookup failed");
+static_assert(config.at("port") == 8080 && config.at("hostname") == 2 &&
+    config.at("") == 0 && config.count("hos") == 0, "static_map at failed");
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Testing of static_map
+/// @ingroup Testing
+////////////////////////////////////////////////////////////////////////////////
+class static_map_test : public test_class {
+
+  protected:
+
+    void test() {
+      test_order();
+
+      test_runtime_lookup();
+
+      test_at_missing();
+
+      test_duplicate_key();
+
+      test_large_table();
+    }
+
+  private:
+
+    /// @brief Test iteration yields keys in std::map order
+    void test_order() {
+      std::map<string, int> s;
+      for(auto&& x : config)
+        s[x.first.str()] = x.second;
+
+      bool ok = s.size() == config.size();
+      auto i = config.begin();
+      for(auto&& x : s)
+        ok = ok && (i++)->first.str() == x.first;
+      auto r = opcodes.rbegin();
+      ok = ok && r->first == 0xe8 && (++r)->first == 0xc3;
+      assert_msg(ok, "Static order failed.");
+    }
+
+    /// @brief Test lookups with keys known only at runtime
+    void test_runtime_lookup() {
+      string k = "timeout";
+      int op = 0x29;
+
+      assert_msg(config.at(k) == 30 && config.find(string("nope")) ==
+          config.end() && string(opcodes.at(op)) == "sub" &&
+          opcodes.find(op)->second == opcodes.at(op),
+          "Static runtime lookup failed.");
+    }
+
+    /// @brief Test at throws for missing keys
+    void test_at_missing() {
+      try {
+        opcodes.at(7);
+        assert_msg(false, "Static at not exists failed");
+      }
+      catch(const std::out_of_range&) {
+        //test success!
+      }
+    }
+
+    /// @brief Test tables built at runtime reject duplicate keys
+    void test_duplicate_key() {
+      try {
+        static_map<int, int, 3> m({{1, 1}, {2, 2}, {1, 3}});
+        assert_msg(m.size() == 0, "Static duplicate key failed");
+      }
+      catch(const std::invalid_argument&) {
+        //test success!
+      }
+    }
+
+    /// @brief Test a larger table, in reverse order
+    void test_large_table() {
+      constexpr static_map<int, int, 64> m({
+#define E(i) {64 - i, i}
+          E(0), E(1), E(2), E(3), E(4), E(5), E(6), E(7), E(8), E(9),
+          E(10), E(11), E(12), E(13), E(14), E(15), E(16), E(17), E(18),
+          E(19), E(20), E(21), E(22), E(23), E(24), E(25), E(26), E(27),
+          E(28), E(29), E(30), E(31), E(32), E(33), E(34), E(35), E(36),
+          E(37), E(38), E(39), E(40), E(41), E(42), E(43), E(44), E(45),
+          E(46), E(47), E(48), E(49), E(50), E(51), E(52), E(53), E(54),
+          E(55), E(56), E(57), E(58), E(59), E(60), E(61), E(62), E(63)});
+#undef E
+      static_assert(m.at(1) == 63 && m.begin()->first == 1, "");
+
+      bool ok = true;
+      for(int k = 0; k <= 65; ++k)
+        ok = ok && m.count(k) == (k >= 1 && k <= 64) &&
+          (!m.count(k) || m.at(k) == 64 - k);
+
+      // thousands of entries in scrambled order, within default limits
+      static constexpr std::pair<const int, int> e[2048] = {
+#define E(i) {(i) * 7919 % 2048, i}
+#define E4(i) E(i), E(i + 1), E(i + 2), E(i + 3)
+#define E16(i) E4(i), E4(i + 4), E4(i + 8), E4(i + 12)
+#define E64(i) E16(i), E16(i + 16), E16(i + 32), E16(i + 48)
+#define E256(i) E64(i), E64(i + 64), E64(i + 128), E64(i + 192)
+          E256(0), E256(256), E256(512), E256(768), E256(1024), E256(1280),
+          E256(1536), E256(1792)};
+#undef E256
+#undef E64
+#undef E16
+#undef E4
+#undef E
+      static constexpr static_map<int, int, 2048> big(e);
+      static_assert(big.begin()->first == 0 &&
+          (big.end() - 1)->first == 2047 && big.at(7919 % 2048) == 1, "");
+      for(int k = 0; k < 2048; ++k)
+        ok = ok && big.begin()[k].first == k &&
+          big.at(k) * 7919 % 2048 == k;
+
+      assert_msg(ok, "Static large table failed.");
+    }
+};
+
+int main() {
+  static_map_test lt;
+
+  if(lt.run())
+    std::cout << "All tests passed." << std::endl;
+
+  return 0;
+}
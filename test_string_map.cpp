@@ -0,0 +1,232 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "string_map.h"
+
+#include "unit_test.h"
+
+using std::string;
+using std::pair;
+using std::make_pair;
+using mystl::compact_string;
+using mystl::string_map;
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Testing of compact_string and string_map
+/// @ingroup Testing
+////////////////////////////////////////////////////////////////////////////////
+class string_map_test : public test_class {
+
+  protected:
+
+    void test() {
+      test_compact_string();
+
+      test_element_access();
+
+      test_order();
+
+      test_random_against_std_map();
+
+      test_std_string_keys();
+
+      test_memory_usage();
+
+      test_indexed();
+
+      test_copy();
+    }
+
+  private:
+
+    /// @brief Key sharing a long prefix with its neighbours
+    /// @param i Key number
+    /// @return Key such as "https://example.com/a/b/12"
+    static string url(int i) {
+      std::ostringstream s;
+      s << "https://example.com/" << char('a' + i % 3) << "/"
+        << char('a' + i / 3 % 5) << "/" << i;
+      return s.str();
+    }
+
+    /// @brief Test construction, copy, comparison and output
+    void test_compact_string() {
+      compact_string e;
+      compact_string a("abc");
+      compact_string b(string("abd"));
+      compact_string c(a);
+      compact_string d;
+      d = std::move(b);
+      std::ostringstream os;
+      os << a << d;
+
+      assert_msg(e.empty() && e.size() == 0 && e.str() == "" && a[1] == 'b' &&
+          a.size() == 3 && c == a && a < d && d > a && a <= c && !(a < c) &&
+          compact_string("ab") < a && b.empty() && os.str() == "abcabd" &&
+          compact_string("\xff") > a && a.str() == "abc" &&
+          compact_string("abcd", 3) == a,
+          "Compact string failed.");
+
+      // a key sharing its neighbour's prefix keeps its value and order
+      string p = "https://example.com/services/frontend/";
+      compact_string f(p + "a"), g(p + "b"), h(p + "c");
+      share_prefix(g, f);
+      share_prefix(h, g);
+      compact_string i(h);
+      f = compact_string();
+      bool ok = g.str() == p + "b" && h.str() == p + "c" && i == h &&
+        g < h && key_bytes(h) < key_bytes(compact_string(p + "c")) &&
+        std::hash<compact_string>()(h) ==
+        std::hash<compact_string>()(compact_string(p + "c"));
+      assert_msg(ok, "Compact string prefix sharing failed.");
+
+      try {
+        compact_string l("", size_t(UINT32_MAX) + 1);
+        assert_msg(false, "Compact string length limit failed.");
+      }
+      catch(const std::length_error&) {
+        //test success!
+      }
+    }
+
+    /// @brief Test element access through string literals and std::string
+    void test_element_access() {
+      string_map<int> m;
+      m["hello"] = 1;
+      m[string("world")] = 2;
+      m.insert(make_pair("hello", 3));
+
+      assert_msg(m.size() == 2 && m.at("hello") == 3 && m["world"] == 2 &&
+          m.count("hell") == 0 && m.find(string("world"))->second == 2,
+          "String map element access failed.");
+    }
+
+    /// @brief Test iteration order matches std::string order
+    void test_order() {
+      string_map<int> m;
+      std::vector<string> keys = {"b", "ab", "a", "", "abc", "b\x80", "B"};
+      for(size_t i = 0; i < keys.size(); ++i)
+        m[keys[i]] = int(i);
+      std::sort(keys.begin(), keys.end());
+
+      bool ok = m.size() == keys.size();
+      size_t i = 0;
+      for(auto&& x : m)
+        ok = ok && x.first.str() == keys[i++];
+      assert_msg(ok, "String map order failed.");
+    }
+
+    /// @brief Test random operations on prefix-sharing keys against std::map
+    void test_random_against_std_map() {
+      string_map<int> m;
+      std::map<string, int> s;
+      srand(13);
+      bool ok = true;
+      for(int i = 0; i < 30000 && ok; ++i) {
+        string k = url(rand() % 2000);
+        switch(rand() % 3) {
+          case 0: m[k] = i; s[k] = i; break;
+          case 1: ok = m.erase(k) == s.erase(k); break;
+          default: ok = m.count(k) == s.count(k);
+        }
+      }
+      ok = ok && m.size() == s.size();
+      string_map<int>::iterator j = m.begin();
+      for(auto&& x : s) {
+        ok = ok && j->first.str() == x.first && j->second == x.second;
+        ++j;
+      }
+      assert_msg(ok, "String map random operations failed.");
+    }
+
+    /// @brief Test the shared-prefix search of a map keyed by std::string
+    void test_std_string_keys() {
+      mystl::map<string, int> m;
+      std::map<string, int> s;
+      for(int i = 0; i < 3000; ++i) {
+        string k = url((i * 7919) % 3000);
+        m[k] = s[k] = i;
+      }
+      bool ok = true;
+      for(int i = -100; i < 3100; ++i) {
+        string k = url(i);
+        k += i % 2 ? "" : "/";
+        ok = ok && m.count(k) == s.count(k) &&
+          (!s.count(k) || m.at(k) == s[k]);
+      }
+      assert_msg(ok, "String keys failed.");
+    }
+
+    /// @brief Test compact keys use less memory than std::string keys,
+    ///        their bytes included
+    void test_memory_usage() {
+      string_map<int> m;
+      mystl::map<string, int> s;
+      for(int i = 0; i < 1000; ++i) {
+        m[url(i)] = i;
+        s[url(i)] = i;
+      }
+      bool ok = m.memory_usage().total() * 3 < s.memory_usage().total() * 2;
+
+      // hierarchical names with long shared prefixes keep only their tails
+      string_map<int> n;
+      mystl::map<string, int> t;
+      for(int i = 0; i < 20000; ++i) {
+        int j = i * 7919 % 20000;
+        std::ostringstream k;
+        k << "https://metrics.example.com/services/frontend/latency/"
+          << (j % 4 ? "p99/host-" : "p50/host-") << j;
+        n[k.str()] = t[k.str()] = i;
+      }
+      mystl::map<string, int>::memory_stats a = t.memory_usage();
+      string_map<int>::memory_stats b = n.memory_usage();
+      ok = ok && b.keys * 2 < a.keys && b.total() * 3 < a.total() * 2;
+      assert_msg(ok, "String map memory usage failed.");
+    }
+
+    /// @brief Test an indexed string map
+    void test_indexed() {
+      string_map<int, 0, true> m;
+      for(int i = 0; i < 500; ++i)
+        m[url(i)] = i;
+      m.erase(url(7));
+
+      bool ok = m.size() == 499 && m.find(url(7)) == m.end();
+      for(int i = 0; i < 500; ++i)
+        ok = ok && (i == 7 || m.at(url(i)) == i);
+      assert_msg(ok, "Indexed string map failed.");
+    }
+
+    /// @brief Test copy construction and assignment are deep
+    void test_copy() {
+      string_map<int> m1;
+      for(int i = 0; i < 100; ++i)
+        m1[url(i)] = i;
+      string_map<int> m2(m1);
+      string_map<int> m3;
+      m3["x"] = 1;
+      m3 = m1;
+
+      m2[url(1)] = -1;
+      m3.erase(url(2));
+
+      assert_msg(m1.size() == 100 && m2.size() == 100 && m3.size() == 99 &&
+          m1.at(url(1)) == 1 && m2.at(url(1)) == -1 && m1.count(url(2)) == 1,
+          "String map copy failed.");
+    }
+};
+
+int main() {
+  string_map_test lt;
+
+  if(lt.run())
+    std::cout << "All tests passed." << std::endl;
+
+  return 0;
+}
@@ -4,12 +4,23 @@
 
 #include <chrono>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <iomanip>
 #include <iostream>
 #include <string>
 #include <utility>
 
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 #include "map.h"
+#include "radix_map.h"
+#include "workloads.h"
 
 using namespace std;
 using namespace chrono;
@@ -58,44 +69,315 @@ void insert_n_random(size_t n) {
   }
 }
 
+/// @brief Function to time n inserts of random data into a radix_map
+/// @param n Input size
+void insert_n_random_radix(size_t n) {
+  using mystl::radix_map;
+  // call code to time
+  radix_map<int, int> m;
+  for(size_t i = 0; i < n; ++i) {
+    int j = rand();
+    m[j] = j;
+  }
+}
+
+/// @tparam Balance Balancing policy of the map
+/// @return Map searched by find_n_zipf, built by build_zipf_map
+template<typename Balance>
+mystl::map<int, int, 0, false, Balance>& zipf_map() {
+  static mystl::map<int, int, 0, false, Balance> m;
+  return m;
+}
+
+/// @brief Untimed setup of find_n_zipf, building a map of n keys scattered
+///        over the key space
+/// @tparam Balance Balancing policy of the map
+/// @param n Input size
+template<typename Balance>
+void build_zipf_map(size_t n) {
+  mystl::map<int, int, 0, false, Balance>& m = zipf_map<Balance>();
+  m.clear();
+  for(size_t i = 0; i < n; ++i)
+    m[int(i * 2654435761u)] = i;
+}
+
+/// @brief Function to time n skewed finds in the map of n keys built by
+///        build_zipf_map
+/// @tparam Balance Balancing policy of the map
+/// @param n Input size
+///
+/// Key ranks are drawn as floor(n^u) for uniform u, roughly Zipfian with
+/// exponent 1. Only the finds are timed, so the policies are compared on
+/// lookups alone; repetitions search the same map, which a splay tree keeps
+/// adapting to the skew.
+template<typename Balance>
+void find_n_zipf(size_t n) {
+  mystl::map<int, int, 0, false, Balance>& m = zipf_map<Balance>();
+  // call code to time
+  int s = 0;
+  for(size_t i = 0; i < n; ++i) {
+    size_t r = size_t(pow(double(n), double(rand()) / RAND_MAX)) - 1;
+    s += m.find(int(r * 2654435761u))->second;
+  }
+  if(s == -1) cout << s;
+}
+
+/// @brief Report update throughput of insert_erase_n_random
+/// @tparam Balance Balancing policy of the map
+/// @param n Input size
+/// @param name Name of the policy for nice output
+///
+/// Only updates that changed the map count. Rotations per update are
+/// reported by the rotations benchmark, which counts them.
+template<typename Balance>
+void report_throughput(size_t n, string name) {
+  high_resolution_clock::time_point start = high_resolution_clock::now();
+  size_t updates = insert_erase_n_random<Balance>(n);
+  high_resolution_clock::time_point stop = high_resolution_clock::now();
+  duration<double> diff = duration_cast<duration<double>>(stop - start);
+  cout << setw(15) << name << setw(15) << n << setw(15) << updates
+    << setw(20) << updates / diff.count() << endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Hardware performance counters wrapped around a timed region
+///
+/// Each counter is opened independently through Linux \c perf_event_open so
+/// that a missing event (common in VMs and containers, or with a restrictive
+/// \c perf_event_paranoid) only disables that column. On other platforms, or
+/// when no counter could be opened, the counters report as unavailable and
+/// timing proceeds with wall clock only.
+///
+/// The kernel multiplexes counters when there are more events than hardware
+/// counters, so each one runs for only part of the region. Counts are scaled
+/// up by the time enabled over the time running. A counter that never got
+/// scheduled has no count and reports as n/a.
+////////////////////////////////////////////////////////////////////////////////
+class perf_counters {
+  public:
+    /// @brief Number of tracked events
+    static const size_t num_events = 6;
+
+    /// @brief Constructor, opens all counters that the host supports
+    perf_counters() {
+      for(size_t i = 0; i < num_events; ++i) {
+        fd[i] = -1;
+        count[i] = -1;
+      }
+#ifdef __linux__
+      const uint64_t l1d_miss = PERF_COUNT_HW_CACHE_L1D |
+        (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+      const uint64_t llc_miss = PERF_COUNT_HW_CACHE_LL |
+        (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+      const uint64_t dtlb_miss = PERF_COUNT_HW_CACHE_DTLB |
+        (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+      fd[0] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+      fd[1] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+      fd[2] = open(PERF_TYPE_HW_CACHE, l1d_miss);
+      fd[3] = open(PERF_TYPE_HW_CACHE, llc_miss);
+      fd[4] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+      fd[5] = open(PERF_TYPE_HW_CACHE, dtlb_miss);
+#endif
+    }
+
+    /// @brief Destructor, closes all open counters
+    ~perf_counters() {
+#ifdef __linux__
+      for(size_t i = 0; i < num_events; ++i)
+        if(fd[i] != -1)
+          close(fd[i]);
+#endif
+    }
+
+    /// @brief Copy construction - Deleted
+    perf_counters(const perf_counters&) = delete;
+    /// @brief Copy assignment - Deleted
+    perf_counters& operator=(const perf_counters&) = delete;
+
+    /// @return Could any counter be opened?
+    bool available() const {
+      for(size_t i = 0; i < num_events; ++i)
+        if(fd[i] != -1)
+          return true;
+      return false;
+    }
+
+    /// @param i Event index
+    /// @return Could counter \c i be opened?
+    bool available(size_t i) const {return fd[i] != -1;}
+
+    /// @brief Reset and start all counters
+    void start() {
+#ifdef __linux__
+      for(size_t i = 0; i < num_events; ++i)
+        if(fd[i] != -1) {
+          ioctl(fd[i], PERF_EVENT_IOC_RESET, 0);
+          ioctl(fd[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    /// @brief Stop all counters and latch their values, scaled for the time
+    ///        they were multiplexed out
+    void stop() {
+#ifdef __linux__
+      for(size_t i = 0; i < num_events; ++i)
+        if(fd[i] != -1) {
+          ioctl(fd[i], PERF_EVENT_IOC_DISABLE, 0);
+          uint64_t c[3]; // value, time enabled, time running
+          if(read(fd[i], c, sizeof(c)) != sizeof(c) || c[2] == 0)
+            count[i] = -1;
+          else
+            count[i] = double(c[0]) * c[1] / c[2];
+        }
+#endif
+    }
+
+    /// @param i Event index
+    /// @return Did counter \c i count during the last start/stop?
+    bool counted(size_t i) const {return count[i] >= 0;}
+
+    /// @param i Event index
+    /// @return Latched count of event \c i from the last start/stop, scaled
+    ///         to the whole region
+    double value(size_t i) const {return count[i];}
+
+    /// @param i Event index
+    /// @return Column header of event \c i
+    static const char* name(size_t i) {
+      static const char* names[num_events] =
+        {"Cycles", "Instrs", "L1D-miss", "LLC-miss", "Br-miss", "dTLB-miss"};
+      return names[i];
+    }
+
+  private:
+#ifdef __linux__
+    /// @brief Open a single user-space counter, initially disabled
+    /// @param type perf event type
+    /// @param config perf event config
+    /// @return File descriptor, or -1 when unsupported
+    static int open(uint32_t type, uint64_t config) {
+      perf_event_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = type;
+      attr.config = config;
+      attr.disabled = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+        PERF_FORMAT_TOTAL_TIME_RUNNING;
+      long r = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+      return r < 0 ? -1 : int(r);
+    }
+#endif
+
+    int fd[num_events];         ///< Counter file descriptors, -1 if missing
+    double count[num_events];   ///< Counts latched by the last stop, -1 if
+                                ///< the counter never ran
+};
+
+/// @brief Enable hardware counter columns in time_function
+bool profile_counters = false;
+
 /// @brief Control timing of a single function
 /// @tparam Func Function type
 /// @param f Function taking a single size_t parameter
 /// @param max_size Maximum size of test. For linear - 2^23 is good, for
 ///                 quadrati - 2^18 is probably good enough, but its up to you.
 /// @param name Name of function for nice output
+/// @param setup Function run with each input size before its timing starts,
+///              untimed
 ///
 /// Essentially this function outputs timings for powers of 2 from 2 to
 /// max_size. For each timing it repeats the test at least 10 times to ensure
 /// a good average time.
+///
+/// When profile_counters is set, the same region is also measured with
+/// hardware counters and each count is reported per operation, i.e., divided
+/// by the number of repetitions times the input size.
 template<typename Func>
-void time_function(Func f, size_t max_size, string name) {
+void time_function(Func f, size_t max_size, string name,
+    void (*setup)(size_t) = nullptr) {
+  perf_counters pc;
+  bool counters = profile_counters && pc.available();
+
   cout << "Function: " << name << endl;
-  cout << setw(15) << "Size" << setw(15) << "Time(sec)" << endl;
+  if(profile_counters && !counters)
+    cout << "Hardware counters unavailable, reporting time only" << endl;
+  cout << setw(15) << "Size" << setw(15) << "Time(sec)";
+  if(counters)
+    for(size_t k = 0; k < perf_counters::num_events; ++k)
+      cout << setw(12) << pc.name(k);
+  cout << endl;
 
   // Loop to control input size
   for(size_t i = 2; i < max_size; i*=2) {
     cout << setw(15) << i;
 
+    // loop a specific number of times to make the clock tick
+    size_t num_itr = max(size_t(10), max_size / i);
+    if(setup)
+      setup(i);
+
     // create a clock
+    if(counters)
+      pc.start();
     high_resolution_clock::time_point start = high_resolution_clock::now();
 
-    // loop a specific number of times to make the clock tick
-    size_t num_itr = max(size_t(10), max_size / i);
     for(size_t j = 0; j < num_itr; ++j)
       f(i);
 
     // calculate time
     high_resolution_clock::time_point stop = high_resolution_clock::now();
+    if(counters)
+      pc.stop();
     duration<double> diff = duration_cast<duration<double>>(stop - start);
 
-    cout << setw(15) << diff.count() / num_itr << endl;
+    cout << setw(15) << diff.count() / num_itr;
+    if(counters) {
+      double ops = double(num_itr) * i;
+      for(size_t k = 0; k < perf_counters::num_events; ++k) {
+        if(pc.counted(k))
+          cout << setw(12) << fixed << setprecision(2) << pc.value(k) / ops;
+        else
+          cout << setw(12) << "n/a";
+        cout.unsetf(ios::floatfield);
+        cout << setprecision(6);
+      }
+    }
+    cout << endl;
   }
 }
 
 /// @brief Main function to time all your functions
-int main() {
+/// @param argc Argument count
+/// @param argv Arguments, \c --perf enables hardware counter columns
+int main(int argc, char** argv) {
+  for(int i = 1; i < argc; ++i)
+    if(string(argv[i]) == "--perf")
+      profile_counters = true;
+
   time_function(insert_n_linear_height_tree, pow(2, 15), "Linear height n inserts");
   time_function(insert_n_logarithmic_height_tree, pow(2, 22), "Logarithmic height n inserts");
   time_function(insert_n_random, pow(2, 20), "Random n inserts");
+  time_function(insert_n_random_radix, pow(2, 20), "Random n inserts (radix_map)");
+  time_function(find_n_zipf<mystl::avl_policy>, pow(2, 20), "Zipf n finds (AVL)",
+      build_zipf_map<mystl::avl_policy>);
+  time_function(find_n_zipf<mystl::splay_policy>, pow(2, 20), "Zipf n finds (splay)",
+      build_zipf_map<mystl::splay_policy>);
+  time_function(find_n_zipf<mystl::treap_policy>, pow(2, 20), "Zipf n finds (treap)",
+      build_zipf_map<mystl::treap_policy>);
+  time_function(insert_erase_n_random<mystl::avl_policy>, pow(2, 20), "Random n inserts and erases (AVL)");
+  time_function(insert_erase_n_random<mystl::wavl_policy>, pow(2, 20), "Random n inserts and erases (WAVL)");
+
+  cout << "Throughput of random inserts and erases" << endl;
+  cout << setw(15) << "Policy" << setw(15) << "Size" << setw(15) << "Updates"
+    << setw(20) << "Updates/sec" << endl;
+  report_throughput<mystl::avl_policy>(pow(2, 20), "AVL");
+  report_throughput<mystl::wavl_policy>(pow(2, 20), "WAVL");
+  report_throughput<mystl::treap_policy>(pow(2, 20), "treap");
 }
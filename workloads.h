@@ -0,0 +1,37 @@
+#ifndef _WORKLOADS_H_
+#define _WORKLOADS_H_
+
+#include <cstdlib>
+#include <utility>
+
+#include "map.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// @brief Workloads shared by the timing and rotation benchmarks
+////////////////////////////////////////////////////////////////////////////////
+
+/// @brief Function to time a write-heavy mix: n random inserts, then n rounds
+///        of one random erase and one random insert
+/// @tparam Balance Balancing policy of the map
+/// @param n Input size
+/// @return Number of updates that changed the map, inserts of new keys and
+///         erases of present ones
+///
+/// Keys are drawn from [0, 2n), so about half the erases miss and many
+/// inserts only replace a value; neither counts as an update.
+template<typename Balance>
+size_t insert_erase_n_random(size_t n) {
+  using mystl::map;
+  map<int, int, 0, false, Balance> m;
+  int range = int(2 * n);
+  size_t updates = 0;
+  for(size_t i = 0; i < n; ++i)
+    updates += m.insert(std::make_pair(rand() % range, int(i))).second;
+  for(size_t i = 0; i < n; ++i) {
+    updates += m.erase(rand() % range);
+    updates += m.insert(std::make_pair(rand() % range, int(i))).second;
+  }
+  return updates;
+}
+
+#endif